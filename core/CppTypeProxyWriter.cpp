@@ -15,14 +15,158 @@
 
 using namespace polyglot;
 
+//! Returns the expression that passes `param` on from a shim to the wrapped function. Named rvalue references are
+//! lvalues, so they have to be moved again. Arrays are passed to shims as pointers to the whole array, which have to be
+//! dereferenced so that the array decays or binds to a reference again.
+static std::string getForwardedArgument(const VariableNode &param)
+{
+    if (param.type.isRvalueReference)
+        return "std::move(" + param.name + ')';
+    if (param.type.isPointer && !param.type.isArray && !param.type.arrayExtents.empty())
+        return '*' + param.name;
+    return param.name;
+}
+
+//! Returns the name that generated code calls `function` by. For template specializations, this differs from the name
+//! in the bindings.
+static std::string getCppName(const FunctionNode &function)
+{
+    return function.cppName.empty() ? function.functionName : function.cppName;
+}
+
 void CppTypeProxyWriter::generateNeededProxies(polyglot::AST &ast, std::ostream &out)
+{
+    std::stringstream buffer;
+    generateFunctionProxies(ast, "", buffer);
+    bool wroteFutureWatcher = false;
+    for (const auto &containerType : Utils::getContainerTypes(ast))
+    {
+        if (containerType.baseType == Type::CppStdVector)
+            writeVectorHelpers(containerType, buffer);
+        else if (containerType.baseType == Type::CppStdFuture)
+        {
+            // All the future types share one watcher thread, so its class is only written once.
+            if (!wroteFutureWatcher)
+                writeFutureWatcher(buffer);
+            wroteFutureWatcher = true;
+            writeFutureHelpers(containerType, buffer);
+        }
+        else if (containerType.baseType == Type::CppStdUniquePtr)
+            writeUniquePtrHelpers(containerType, buffer);
+        else if (containerType.baseType == Type::CppStdSharedPtr)
+            writeSharedPtrHelpers(containerType, buffer);
+        else
+            writeMapHelpers(containerType, buffer);
+    }
+    if (Utils::hasMemoryResourceParameters(ast))
+        writeMemoryResourceHelpers(buffer);
+
+    const auto content = buffer.str();
+
+    // If we don't have anything to write to the output, let's not even bother writing a file.
+    if (content.size() <= 0)
+        return;
+
+    auto t = std::time(nullptr);
+    std::string timeStr = std::asctime(std::localtime(&t));
+    out << std::format(
+R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritten. ***
+// Generated by Polyglot version {} at {}.
+// This file contains type proxies for {}.
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../../{}.h"
+
+// The state of a chunked iteration: the current position and the end of the range that is being iterated over.
+template<typename Range>
+using polyglot_iter_state = std::pair<decltype(std::begin(std::declval<Range &>())), decltype(std::end(std::declval<Range &>()))>;
+
+// Calls a C callback with the context pointer it was registered with. It is only two pointers and trivially copyable, so
+// std::function keeps it in its small buffer instead of allocating.
+template<typename Signature>
+struct polyglot_callback;
+template<typename R, typename... Args>
+struct polyglot_callback<R(Args...)>
+{{
+	R (*function)(Args..., void *);
+	void *context;
+
+	R operator()(Args... args) const
+	{{
+		return function(args..., context);
+	}}
+}};
+)",
+        Utils::POLYGLOT_VERSION,
+        timeStr.substr(0, timeStr.size() - 1), // remove the '\n'
+        Utils::getLanguageName(ast), // TODO: use the list of languages that this proxies to
+        ast.moduleName);
+    out << "\n";
+
+    out << content;
+}
+
+void CppTypeProxyWriter::generateFunctionProxies(polyglot::AST &ast, const std::string &scope, std::ostream &out)
 {
     CppWrapperWriter writer;
 
-    std::stringstream buffer;
+    auto needsProxy = [](const QualifiedType &type) {
+        return type.baseType == Type::CppStdString || Utils::isContainerType(type.baseType) ||
+               type.baseType == Type::CppStdUniquePtr;
+    };
+
     for (auto &node : ast.nodes)
     {
-        if (node->nodeType() == ASTNodeType::Function)
+        if (node->nodeType() == ASTNodeType::Namespace)
+        {
+            auto ns = dynamic_cast<NamespaceNode *>(node);
+            if (ns == nullptr)
+                throw std::runtime_error("Node claimed to be NamespaceNode, but cast failed");
+
+            generateFunctionProxies(ns->ast, scope + ns->name + "::", out);
+        }
+        else if (node->nodeType() == ASTNodeType::Class)
+        {
+            auto classNode = dynamic_cast<ClassNode *>(node);
+            if (classNode == nullptr)
+                throw std::runtime_error("Node claimed to be ClassNode, but cast failed");
+
+            for (const auto &method : classNode->methods)
+            {
+                if (method.isInline)
+                    writeShim(method, scope, classNode, out);
+                if (method.hasReturnSlot)
+                    writeShim(method, scope, classNode, out, true);
+            }
+            writeLifetimeShims(*classNode, out);
+
+            if (classNode->iteratorValueType)
+                writeClassIteratorHelpers(*classNode, out);
+        }
+        else if (node->nodeType() == ASTNodeType::Variable)
+        {
+            auto variable = dynamic_cast<VariableNode *>(node);
+            if (variable == nullptr)
+                throw std::runtime_error("Node claimed to be VariableNode, but cast failed");
+
+            // An inline variable is only emitted by the translation units that use it, so this one takes its address to
+            // make sure that the bindings have a symbol to link against.
+            if (variable->isInline && !variable->isConstexpr)
+                out << "[[gnu::used]] static const void *" << variable->mangledName << "_polyglot_keep = &" << scope
+                    << variable->name << ";\n";
+        }
+        else if (node->nodeType() == ASTNodeType::Function)
         {
             auto function = dynamic_cast<FunctionNode *>(node);
             if (function == nullptr)
@@ -30,98 +174,657 @@ void CppTypeProxyWriter::generateNeededProxies(polyglot::AST &ast, std::ostream
             if (function->typeProxy.isValid)
                 continue;
 
-            auto returnsStdString = function->returnType.baseType == Type::CppStdString;
-            auto hasStdStringParam =
-                std::find_if(function->parameters.cbegin(), function->parameters.cend(), [](const auto &param) {
-                    return param.type.baseType == Type::CppStdString;
+            if (function->isBatched)
+                writeBatch(*function, scope, out);
+            if (std::any_of(function->parameters.cbegin(), function->parameters.cend(), [](const auto &param) {
+                    return param.type.baseType == Type::CppStdFunction;
+                }))
+            {
+                writeCallbackShim(*function, scope, out);
+                continue;
+            }
+
+            const auto isReturnProxied = needsProxy(function->returnType);
+            const auto hasProxiedParam =
+                std::find_if(function->parameters.cbegin(), function->parameters.cend(), [&needsProxy](const auto &param) {
+                    return needsProxy(param.type);
                 }) != function->parameters.cend();
-            if (returnsStdString || hasStdStringParam)
+            if (!isReturnProxied && !hasProxiedParam)
+            {
+                if (function->isInline)
+                    writeShim(*function, scope, nullptr, out);
+                if (function->hasReturnSlot)
+                    writeShim(*function, scope, nullptr, out, true);
+                continue;
+            }
+
+            function->typeProxy.isValid = true;
+            function->typeProxy.isReturnProxied = isReturnProxied;
+            function->typeProxy.proxy = new FunctionNode{*function};
+            auto proxy = function->typeProxy.proxy;
+            // TODO: try to mangle this as a regular C++ function instead of just using extern "C" so overrides can work
+            proxy->functionName = function->functionName + "_polyglot_typeproxy";
+            // Basing the symbol on the mangled name keeps proxies for overloads and namespaced functions apart.
+            proxy->mangledName = function->mangledName + "_polyglot_typeproxy";
+            // The proxy itself is always emitted out of line, so an inline function doesn't need a separate shim.
+            proxy->isInline = false;
+            // Converting strings and containers allocates, so the proxy can throw and doesn't share the function's purity.
+            // Passing on the pointer that a std::unique_ptr owns doesn't.
+            auto isConverted = [](const QualifiedType &type) {
+                return type.baseType == Type::CppStdString || Utils::isContainerType(type.baseType);
+            };
+            if (isConverted(function->returnType) ||
+                std::any_of(function->parameters.cbegin(), function->parameters.cend(), [&isConverted](const auto &param) {
+                    return isConverted(param.type);
+                }))
+            {
+                proxy->isNothrow = false;
+                proxy->isPure = false;
+                proxy->isConstFunction = false;
+            }
+
+            out << "extern \"C\" ";
+            switch (function->returnType.baseType)
+            {
+            case Type::CppStdString:
+                proxy->returnType = QualifiedType{Type::Char};
+                proxy->returnType.isConst = true;
+                proxy->returnType.isPointer = true;
+                out << "const char *";
+                break;
+            case Type::CppStdVector:
+            case Type::CppStdMap:
+            case Type::CppStdUnorderedMap:
+            case Type::CppStdFuture:
+            case Type::CppStdSharedPtr:
+                // Returned containers are moved into a heap-allocated container that the wrapper takes ownership of.
+                proxy->returnType = QualifiedType{Type::Void};
+                proxy->returnType.isPointer = true;
+                out << writer.getTypeString(getUnqualifiedType(function->returnType)) << " *";
+                break;
+            case Type::CppStdUniquePtr:
+                // The wrapper's handle takes over the pointer that the std::unique_ptr owned.
+                proxy->returnType = function->returnType.templateArguments.at(0);
+                proxy->returnType.isPointer = true;
+                out << writer.getTypeString(proxy->returnType);
+                break;
+            default:
+                out << writer.getTypeString(function->returnType) << ' ';
+                break;
+            }
+
+            out << proxy->mangledName << '(';
+
+            std::string params;
+            std::string args;
+            for (auto &param : proxy->parameters)
             {
-                function->typeProxy.isValid = true;
-                function->typeProxy.isReturnProxied = returnsStdString;
-                function->typeProxy.proxy = new FunctionNode{*function};
-                // TODO: try to mangle this as a regular C++ function instead of just using extern "C" so overrides can work
-                function->typeProxy.proxy->functionName = function->functionName + "_polyglot_typeproxy";
-                function->typeProxy.proxy->mangledName = function->typeProxy.proxy->functionName;
-
-                buffer << "extern \"C\" ";
-                QualifiedType oldReturnType = function->returnType;
-                if (returnsStdString)
+                if (param.type.baseType == Type::CppStdString)
+                {
+                    function->typeProxy.proxiedParameters.push_back(param.name);
+                    params += "const char *";
+                    param.type = QualifiedType{Type::Char};
+                    param.type.isConst = true;
+                    param.type.isPointer = true;
+                    args += param.name;
+                }
+                else if (Utils::isContainerType(param.type.baseType))
+                {
+                    // Containers are passed as a pointer to the container owned by the wrapper's handle, so the C++
+                    // function sees the caller's storage directly. Only non-const references are allowed to modify it.
+                    function->typeProxy.proxiedParameters.push_back(param.name);
+                    const auto isConst = param.type.isConst || !param.type.isReference;
+                    if (isConst)
+                        params += "const ";
+                    params += writer.getTypeString(getUnqualifiedType(param.type)) + " *";
+                    param.type = QualifiedType{Type::Void};
+                    param.type.isConst = isConst;
+                    param.type.isPointer = true;
+                    args += '*' + param.name;
+                }
+                else if (param.type.baseType == Type::CppStdUniquePtr)
                 {
-                    function->typeProxy.proxy->returnType = QualifiedType{Type::Char};
-                    function->typeProxy.proxy->returnType.isConst = true;
-                    function->typeProxy.proxy->returnType.isPointer = true;
-                    buffer << "const char *";
+                    // The wrapper's handle gives up the pointer it owns, and a std::unique_ptr takes it over.
+                    function->typeProxy.proxiedParameters.push_back(param.name);
+                    const auto uniquePtrType = writer.getTypeString(param.type);
+                    param.type = param.type.templateArguments.at(0);
+                    param.type.isPointer = true;
+                    params += writer.getTypeString(param.type);
+                    args += uniquePtrType + '(' + param.name + ')';
                 }
                 else
-                    buffer << writer.getTypeString(function->returnType) << ' ';
-
-                buffer << function->typeProxy.proxy->mangledName << '(';
-
-                std::string params;
-                for (auto &param : function->typeProxy.proxy->parameters)
                 {
-                    if (param.type.baseType == Type::CppStdString)
-                    {
-                        function->typeProxy.proxiedParameters.push_back(param.name);
-                        params += "const char *";
-                        param.type = QualifiedType{Type::Char};
-                        param.type.isConst = true;
-                        param.type.isPointer = true;
-                    }
-                    else
-                        params += writer.getTypeString(param.type) + ' ';
-                    params += param.name + ", ";
+                    params += writer.getTypeString(param.type) + ' ';
+                    args += param.name;
                 }
-                buffer << params.substr(0, params.size() - 2);
-
-                buffer << ")\n{\n\t";
-                if (function->returnType != QualifiedType{Type::Void})
-                    buffer << "return ";
-                if (returnsStdString)
-                    buffer << "strdup(";
-                buffer << function->functionName << '(';
-
-                params.clear();
-                for (auto &param : function->parameters)
-                    params += param.name + ", ";
-                buffer << params.substr(0, params.size() - 2);
-
-                buffer << ')';
-                if (returnsStdString)
-                    buffer << ".c_str())";
-                buffer << ";\n}\n";
+                params += param.name + ", ";
+                args += ", ";
             }
+            out << params.substr(0, params.size() - 2);
+
+            out << ")\n{\n\t";
+            if (function->returnType != QualifiedType{Type::Void})
+                out << "return ";
+
+            const auto call = scope + getCppName(*function) + '(' + args.substr(0, args.size() - 2) + ')';
+            switch (function->returnType.baseType)
+            {
+            case Type::CppStdString:
+                out << "strdup(" << call << ".c_str())";
+                break;
+            case Type::CppStdVector:
+            case Type::CppStdMap:
+            case Type::CppStdUnorderedMap:
+            case Type::CppStdFuture:
+            case Type::CppStdSharedPtr:
+                out << "new " << writer.getTypeString(getUnqualifiedType(function->returnType)) << '(' << call << ')';
+                break;
+            case Type::CppStdUniquePtr:
+                out << call << ".release()";
+                break;
+            default:
+                out << call;
+                break;
+            }
+            out << ";\n}\n";
         }
     }
+}
 
-    const auto content = buffer.str();
+void CppTypeProxyWriter::writeShim(const polyglot::FunctionNode &function,
+                                   const std::string &scope,
+                                   const polyglot::ClassNode *classNode,
+                                   std::ostream &out,
+                                   bool useReturnSlot)
+{
+    CppWrapperWriter writer;
+    const auto returnType = writer.getTypeString(function.returnType);
 
-    // If we don't have anything to write to the output, let's not even bother writing a file.
-    if (content.size() <= 0)
+    std::string params;
+    std::string args;
+    std::string callee = scope + getCppName(function);
+    if (classNode)
+    {
+        if (function.isStatic)
+            callee = classNode->qualifiedName + "::" + function.functionName;
+        else
+        {
+            params += classNode->qualifiedName + " *self, ";
+            callee = "self->" + function.functionName;
+        }
+    }
+    if (useReturnSlot)
+        params += returnType + " *result, ";
+    for (const auto &param : function.parameters)
+    {
+        params += writer.getTypeString(param.type) + ' ' + param.name + ", ";
+        args += getForwardedArgument(param) + ", ";
+    }
+
+    // The shim only forwards the call, so in an LTO build it is inlined into the caller along with the function itself.
+    if (useReturnSlot)
+    {
+        // The call is a prvalue, so C++17's guaranteed copy elision constructs the result directly in the caller's storage.
+        out << "extern \"C\" void " << Utils::getReturnSlotSymbolName(function) << '(' << params.substr(0, params.size() - 2)
+            << ')' << (function.isNothrow ? " noexcept" : "") << "\n{\n\tnew (result) " << returnType << '(' << callee << '('
+            << args.substr(0, args.size() - 2) << "));\n}\n";
         return;
+    }
+
+    out << "extern \"C\" " << returnType << ' ' << Utils::getSymbolName(function) << '('
+        << params.substr(0, params.size() - 2) << ')' << (function.isNothrow ? " noexcept" : "") << "\n{\n\t";
+    if (function.returnType != QualifiedType{Type::Void})
+        out << "return ";
+    out << callee << '(' << args.substr(0, args.size() - 2) << ");\n}\n";
+}
+
+void CppTypeProxyWriter::writeCallbackShim(const polyglot::FunctionNode &function,
+                                           const std::string &scope,
+                                           std::ostream &out)
+{
+    CppWrapperWriter writer;
+    const auto binding = Utils::getCallbackBinding(function);
 
-    static int s_onlyWriteHeaderOnce = 0;
-    if (s_onlyWriteHeaderOnce == 0)
+    std::string params;
+    for (const auto &param : binding.parameters)
+        params += writer.getTypeString(param.type) + ' ' + param.name + ", ";
+    std::string args;
+    for (const auto &param : function.parameters)
     {
-        auto t = std::time(nullptr);
-        std::string timeStr = std::asctime(std::localtime(&t));
-        out << std::format(
-R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritten. ***
-// Generated by Polyglot version {} at {}.
-// This file contains type proxies for {}.
+        if (param.type.baseType == Type::CppStdFunction)
+            args += "polyglot_callback<" + writer.getSignatureString(param.type) + ">{" + param.name + ", " + param.name +
+                    "_context}, ";
+        else
+            args += param.name + ", ";
+    }
 
-#include <cstring>
+    out << "extern \"C\" " << writer.getTypeString(function.returnType) << ' ' << Utils::getSymbolName(binding) << '('
+        << params.substr(0, params.size() - 2) << ')' << (function.isNothrow ? " noexcept" : "") << "\n{\n\t";
+    if (function.returnType != QualifiedType{Type::Void})
+        out << "return ";
+    out << scope << getCppName(function) << '(' << args.substr(0, args.size() - 2) << ");\n}\n";
+}
 
-#include "../../{}.h"
-)",
-            Utils::POLYGLOT_VERSION,
-            timeStr.substr(0, timeStr.size() - 1), // remove the '\n'
-            Utils::getLanguageName(ast), // TODO: use the list of languages that this proxies to
-            ast.moduleName);
+void CppTypeProxyWriter::writeLifetimeShims(const polyglot::ClassNode &classNode, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    for (const auto &constructor : classNode.constructors)
+    {
+        if (!constructor.isInline || Utils::isCopyConstructor(classNode, constructor))
+            continue;
+
+        std::string params;
+        std::string args;
+        for (const auto &param : constructor.parameters)
+        {
+            params += ", " + writer.getTypeString(param.type) + ' ' + param.name;
+            args += getForwardedArgument(param) + ", ";
+        }
+        out << "extern \"C\" void " << Utils::getSymbolName(constructor) << '(' << classNode.qualifiedName << " *self"
+            << params << ')' << (constructor.isNothrow ? " noexcept" : "") << "\n{\n\tnew (self) "
+            << classNode.qualifiedName << '(' << args.substr(0, args.size() - 2) << ");\n}\n";
     }
-    ++s_onlyWriteHeaderOnce;
-    out << "\n";
 
-    out << content;
+    if (classNode.destructor && classNode.destructor->isInline)
+        out << "extern \"C\" void " << Utils::getSymbolName(*classNode.destructor) << '(' << classNode.qualifiedName
+            << " *self)" << (classNode.destructor->isNothrow ? " noexcept" : "") << "\n{\n\tstd::destroy_at(self);\n}\n";
+}
+
+void CppTypeProxyWriter::writeBatch(const polyglot::FunctionNode &function, const std::string &scope, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    std::string params;
+    std::string args;
+    for (const auto &param : function.parameters)
+    {
+        auto elementType = param.type;
+        elementType.isConst = true;
+        params += writer.getTypeString(elementType) + " *" + param.name + ", ";
+        args += param.name + "[i], ";
+    }
+    const auto hasResults = function.returnType != QualifiedType{Type::Void};
+    if (hasResults)
+        params += writer.getTypeString(function.returnType) + " *results, ";
+
+    out << "extern \"C\" void " << Utils::getBatchSymbolName(function) << '(' << params << "size_t count)"
+        << (function.isNothrow ? " noexcept" : "") << "\n{\n"
+        << "\tfor (size_t i = 0; i < count; ++i)\n\t\t";
+    if (hasResults)
+        out << "results[i] = ";
+    out << scope << getCppName(function) << '(' << args.substr(0, args.size() - 2) << ");\n}\n";
+}
+
+void CppTypeProxyWriter::writeVectorHelpers(const polyglot::QualifiedType &vectorType, std::ostream &out)
+{
+    CppWrapperWriter writer;
+    const auto element = writer.getTypeString(vectorType.templateArguments.at(0));
+
+    // Every module that uses a given vector type gets its own copy of these helpers, so they are marked weak to let the
+    // linker merge them.
+    out << std::format(R"(
+extern "C" __attribute__((weak)) {0} *{1}({5} *v)
+{{
+	return v->data();
+}}
+extern "C" __attribute__((weak)) size_t {2}(const {5} *v)
+{{
+	return v->size();
+}}
+extern "C" __attribute__((weak)) void {3}({5} *v)
+{{
+	delete v;
+}}
+extern "C" __attribute__((weak)) {5} *{4}(const {0} *data, size_t size)
+{{
+	return new {5}(data, data + size);
+}}
+)",
+                       element,
+                       Utils::getHelperName(vectorType, "data"),
+                       Utils::getHelperName(vectorType, "size"),
+                       Utils::getHelperName(vectorType, "delete"),
+                       Utils::getHelperName(vectorType, "from"),
+                       writer.getTypeString(vectorType));
+}
+
+void CppTypeProxyWriter::writeFutureWatcher(std::ostream &out)
+{
+    out << R"(
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// Calls a completion callback once a std::future is ready. std::future can't notify anyone by itself, so a single thread
+// polls all the futures that are being waited on; that way, the bindings can wait for any number of them without
+// blocking a thread each. Polling doesn't block, so it happens under the lock, but the callbacks are called without it.
+// The polling interval backs off while nothing becomes ready.
+class polyglot_future_watcher
+{
+public:
+	static polyglot_future_watcher &instance()
+	{
+		static polyglot_future_watcher watcher;
+		return watcher;
+	}
+
+	void watch(const void *future, bool (*isReady)(const void *), void (*callback)(void *), void *context)
+	{
+		std::lock_guard lock(m_mutex);
+		m_entries.push_back({future, isReady, callback, context});
+		m_interval = s_minInterval;
+		m_condition.notify_one();
+	}
+
+	// After this returns, the callback for `future` won't be called anymore, and the watcher doesn't touch it.
+	void unwatch(const void *future)
+	{
+		std::unique_lock lock(m_mutex);
+		std::erase_if(m_entries, [future](const entry &e) { return e.future == future; });
+		std::erase_if(m_ready, [future](const entry &e) { return e.future == future; });
+		// Its callback may be running right now, unless that callback is what called this.
+		if (std::this_thread::get_id() != m_thread.get_id())
+			m_callbackDone.wait(lock, [this, future] { return m_running != future; });
+	}
+
+private:
+	struct entry
+	{
+		const void *future;
+		bool (*isReady)(const void *);
+		void (*callback)(void *);
+		void *context;
+	};
+
+	static constexpr std::chrono::milliseconds s_minInterval{1};
+	static constexpr std::chrono::milliseconds s_maxInterval{32};
+
+	polyglot_future_watcher()
+		: m_thread{[this] { run(); }}
+	{}
+
+	~polyglot_future_watcher()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_stop = true;
+		}
+		m_condition.notify_one();
+		m_thread.join();
+	}
+
+	void run()
+	{
+		std::unique_lock lock(m_mutex);
+		while (!m_stop)
+		{
+			if (m_entries.empty())
+			{
+				m_condition.wait(lock);
+				continue;
+			}
+
+			const auto ready = std::partition(m_entries.begin(), m_entries.end(), [](const entry &e) { return !e.isReady(e.future); });
+			m_ready.assign(ready, m_entries.end());
+			m_entries.erase(ready, m_entries.end());
+			const auto anyReady = !m_ready.empty();
+
+			// A callback may unwatch other futures whose callbacks are still pending, so they are taken one at a time.
+			while (!m_ready.empty())
+			{
+				const auto e = m_ready.back();
+				m_ready.pop_back();
+				m_running = e.future;
+				lock.unlock();
+				e.callback(e.context);
+				lock.lock();
+				m_running = nullptr;
+				m_callbackDone.notify_all();
+			}
+
+			m_interval = anyReady ? s_minInterval : std::min(m_interval * 2, s_maxInterval);
+			if (!m_stop && !m_entries.empty())
+				m_condition.wait_for(lock, m_interval);
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::condition_variable m_callbackDone;
+	std::vector<entry> m_entries;
+	std::vector<entry> m_ready;
+	const void *m_running = nullptr;
+	std::chrono::milliseconds m_interval = s_minInterval;
+	bool m_stop = false;
+	std::thread m_thread;
+};
+)";
+}
+
+void CppTypeProxyWriter::writeFutureHelpers(const polyglot::QualifiedType &futureType, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    // get() and delete stop watching the future first, since the watcher might still be polling it from its thread.
+    out << std::format(R"(
+extern "C" __attribute__((weak)) bool {1}(const std::future<{0}> *f) noexcept
+{{
+	return f->wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}}
+extern "C" __attribute__((weak)) void {2}(const std::future<{0}> *f, void (*callback)(void *), void *context)
+{{
+	polyglot_future_watcher::instance().watch(f, [](const void *f) {{ return {1}(static_cast<const std::future<{0}> *>(f)); }}, callback, context);
+}}
+extern "C" __attribute__((weak)) {0} {3}(std::future<{0}> *f)
+{{
+	polyglot_future_watcher::instance().unwatch(f);
+	return f->get();
+}}
+extern "C" __attribute__((weak)) void {4}(std::future<{0}> *f) noexcept
+{{
+	polyglot_future_watcher::instance().unwatch(f);
+	delete f;
+}}
+)",
+                       writer.getTypeString(futureType.templateArguments.at(0)),
+                       Utils::getHelperName(futureType, "ready"),
+                       Utils::getHelperName(futureType, "notify"),
+                       Utils::getHelperName(futureType, "get"),
+                       Utils::getHelperName(futureType, "delete"));
+}
+
+void CppTypeProxyWriter::writeUniquePtrHelpers(const polyglot::QualifiedType &uniquePtrType, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    // The handles only hold the pointer itself, so this is all they need to free the pointee like a std::unique_ptr would.
+    out << std::format(R"(
+extern "C" __attribute__((weak)) void {1}({0} *p) noexcept
+{{
+	std::default_delete<{0}>()(p);
+}}
+)",
+                       writer.getTypeString(uniquePtrType.templateArguments.at(0)),
+                       Utils::getHelperName(uniquePtrType, "delete"));
+}
+
+void CppTypeProxyWriter::writeSharedPtrHelpers(const polyglot::QualifiedType &sharedPtrType, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    // Only clone and delete touch the reference count. The wrappers get the pointee once and keep it, so that borrowing
+    // it doesn't even need a call.
+    out << std::format(R"(
+extern "C" __attribute__((weak)) {0} *{1}(const std::shared_ptr<{0}> *p) noexcept
+{{
+	return p->get();
+}}
+extern "C" __attribute__((weak)) std::shared_ptr<{0}> *{2}(const std::shared_ptr<{0}> *p)
+{{
+	return new std::shared_ptr<{0}>(*p);
+}}
+extern "C" __attribute__((weak)) void {3}(std::shared_ptr<{0}> *p) noexcept
+{{
+	delete p;
+}}
+)",
+                       writer.getTypeString(sharedPtrType.templateArguments.at(0)),
+                       Utils::getHelperName(sharedPtrType, "get"),
+                       Utils::getHelperName(sharedPtrType, "clone"),
+                       Utils::getHelperName(sharedPtrType, "delete"));
+}
+
+void CppTypeProxyWriter::writeMemoryResourceHelpers(std::ostream &out)
+{
+    // These don't depend on any types from the module, so they are weak like the container helpers.
+    out << R"(
+#include <memory_resource>
+
+// A std::pmr::memory_resource that allocates through callbacks, so that C++ code can allocate from an allocator of the
+// language that calls it (e.g. an arena). Callers get the memory they asked for even for empty allocations, since not
+// every allocator supports those.
+class polyglot_memory_resource : public std::pmr::memory_resource
+{
+public:
+	using allocate_function = void *(*)(void *context, size_t size, size_t alignment);
+	using deallocate_function = void (*)(void *context, void *p, size_t size, size_t alignment);
+
+	polyglot_memory_resource(allocate_function allocate, deallocate_function deallocate, void *context)
+		: m_allocate{allocate},
+		  m_deallocate{deallocate},
+		  m_context{context}
+	{}
+
+private:
+	void *do_allocate(size_t size, size_t alignment) override
+	{
+		const auto p = m_allocate(m_context, std::max<size_t>(size, 1), alignment);
+		if (!p)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	void do_deallocate(void *p, size_t size, size_t alignment) override
+	{
+		m_deallocate(m_context, p, std::max<size_t>(size, 1), alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+	{
+		return this == &other;
+	}
+
+	allocate_function m_allocate;
+	deallocate_function m_deallocate;
+	void *m_context;
+};
+
+extern "C" __attribute__((weak)) std::pmr::memory_resource *polyglot_memory_resource_new(polyglot_memory_resource::allocate_function allocate, polyglot_memory_resource::deallocate_function deallocate, void *context)
+{
+	return new polyglot_memory_resource(allocate, deallocate, context);
+}
+extern "C" __attribute__((weak)) void polyglot_memory_resource_delete(std::pmr::memory_resource *resource)
+{
+	delete resource;
+}
+)";
+}
+
+void CppTypeProxyWriter::writeMapHelpers(const polyglot::QualifiedType &mapType, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    // Like the vector helpers, these are weak so that several modules can use the same map type. Iteration copies the
+    // entries out in caller-sized chunks so that walking a map doesn't cost a boundary crossing per entry.
+    out << std::format(R"(
+extern "C" __attribute__((weak)) {0} *{3}()
+{{
+	return new {0};
+}}
+extern "C" __attribute__((weak)) size_t {4}(const {0} *m)
+{{
+	return m->size();
+}}
+extern "C" __attribute__((weak)) void {5}({0} *m, {1} key, {2} value)
+{{
+	m->insert_or_assign(key, value);
+}}
+extern "C" __attribute__((weak)) void {6}({0} *m)
+{{
+	delete m;
+}}
+extern "C" __attribute__((weak)) void *{7}(const {0} *m)
+{{
+	return new polyglot_iter_state<const {0}>{{m->begin(), m->end()}};
+}}
+extern "C" __attribute__((weak)) size_t {8}(void *state, {1} *keys, {2} *values, size_t capacity)
+{{
+	auto &[current, end] = *static_cast<polyglot_iter_state<const {0}> *>(state);
+	size_t count = 0;
+	for (; count < capacity && current != end; ++current, ++count)
+	{{
+		keys[count] = current->first;
+		values[count] = current->second;
+	}}
+	return count;
+}}
+extern "C" __attribute__((weak)) void {9}(void *state)
+{{
+	delete static_cast<polyglot_iter_state<const {0}> *>(state);
+}}
+)",
+                       writer.getTypeString(mapType),
+                       writer.getTypeString(mapType.templateArguments.at(0)),
+                       writer.getTypeString(mapType.templateArguments.at(1)),
+                       Utils::getHelperName(mapType, "new"),
+                       Utils::getHelperName(mapType, "size"),
+                       Utils::getHelperName(mapType, "insert"),
+                       Utils::getHelperName(mapType, "delete"),
+                       Utils::getHelperName(mapType, "iter_begin"),
+                       Utils::getHelperName(mapType, "iter_next"),
+                       Utils::getHelperName(mapType, "iter_free"));
+}
+
+void CppTypeProxyWriter::writeClassIteratorHelpers(const polyglot::ClassNode &classNode, std::ostream &out)
+{
+    CppWrapperWriter writer;
+
+    out << std::format(R"(
+extern "C" void *{2}({0} *c)
+{{
+	return new polyglot_iter_state<{0}>{{c->begin(), c->end()}};
+}}
+extern "C" size_t {3}(void *state, {1} *values, size_t capacity)
+{{
+	auto &[current, end] = *static_cast<polyglot_iter_state<{0}> *>(state);
+	size_t count = 0;
+	for (; count < capacity && current != end; ++current, ++count)
+		values[count] = *current;
+	return count;
+}}
+extern "C" void {4}(void *state)
+{{
+	delete static_cast<polyglot_iter_state<{0}> *>(state);
+}}
+)",
+                       classNode.qualifiedName,
+                       writer.getTypeString(*classNode.iteratorValueType),
+                       Utils::getClassHelperName(classNode, "iter_begin"),
+                       Utils::getClassHelperName(classNode, "iter_next"),
+                       Utils::getClassHelperName(classNode, "iter_free"));
+}
+
+polyglot::QualifiedType CppTypeProxyWriter::getUnqualifiedType(const polyglot::QualifiedType &type)
+{
+    QualifiedType ret{type.baseType};
+    ret.nameString = type.nameString;
+    ret.qualifiedName = type.qualifiedName;
+    ret.templateArguments = type.templateArguments;
+    ret.elementCount = type.elementCount;
+    ret.arrayExtents = type.arrayExtents;
+    ret.usesPolymorphicAllocator = type.usesPolymorphicAllocator;
+    return ret;
 }
@@ -10,4 +10,52 @@ public:
     CppTypeProxyWriter() {}
 
     virtual void generateNeededProxies(polyglot::AST &ast, std::ostream &out) override;
+
+private:
+    //! Writes proxies for the functions in `ast`. `scope` is the C++ scope (e.g. "ns::") used to call the functions.
+    void generateFunctionProxies(polyglot::AST &ast, const std::string &scope, std::ostream &out);
+
+    //! Writes an exported, out-of-line shim for an inline function so that the bindings have a symbol to link against. If
+    //! `classNode` is set, the function is one of its methods and the shim takes the object as its first parameter. If
+    //! `useReturnSlot` is set, the shim instead takes a pointer to storage for the result and constructs it there.
+    void writeShim(const polyglot::FunctionNode &function,
+                   const std::string &scope,
+                   const polyglot::ClassNode *classNode,
+                   std::ostream &out,
+                   bool useReturnSlot = false);
+
+    //! Writes the shim for a function that takes std::function parameters. The shim takes each of them as a C callback
+    //! and context pointer (see Utils::getCallbackBinding()) and wraps the pair in a polyglot_callback.
+    void writeCallbackShim(const polyglot::FunctionNode &function, const std::string &scope, std::ostream &out);
+
+    //! Writes shims that construct an object of `classNode` in storage provided by the caller and destroy it again, for
+    //! the constructors and destructor that are inline and therefore may not have a symbol.
+    void writeLifetimeShims(const polyglot::ClassNode &classNode, std::ostream &out);
+
+    //! Writes the batched entry point for a function annotated with "polyglot::batch". It takes one array per parameter
+    //! plus an array for the results, and calls the function once per element.
+    void writeBatch(const polyglot::FunctionNode &function, const std::string &scope, std::ostream &out);
+
+    //! Writes the C helpers that let the wrappers access and free a std::vector.
+    void writeVectorHelpers(const polyglot::QualifiedType &vectorType, std::ostream &out);
+    //! Writes polyglot_future_watcher, which calls the callbacks that the future helpers' notify() registers. It is
+    //! shared by all future types, so it is written once, before the first of them.
+    void writeFutureWatcher(std::ostream &out);
+    //! Writes the C helpers that let the wrappers poll, wait for and free a std::future. notify() registers a callback
+    //! that is called once the future is ready, which is what lets the wrappers wait without blocking a thread.
+    void writeFutureHelpers(const polyglot::QualifiedType &futureType, std::ostream &out);
+    //! Writes the C helper that lets the wrappers free the pointee of a std::unique_ptr that they took over.
+    void writeUniquePtrHelpers(const polyglot::QualifiedType &uniquePtrType, std::ostream &out);
+    //! Writes the C helpers that let the wrappers get the pointee of, copy and free a std::shared_ptr.
+    void writeSharedPtrHelpers(const polyglot::QualifiedType &sharedPtrType, std::ostream &out);
+    //! Writes the C helpers that let the wrappers create and free a polyglot_memory_resource, which wraps their own
+    //! allocators in a std::pmr::memory_resource.
+    void writeMemoryResourceHelpers(std::ostream &out);
+    //! Writes the C helpers that let the wrappers build, iterate over and free a std::map or std::unordered_map.
+    void writeMapHelpers(const polyglot::QualifiedType &mapType, std::ostream &out);
+    //! Writes the C helpers that let the wrappers iterate over a class with begin() and end() in chunks.
+    void writeClassIteratorHelpers(const polyglot::ClassNode &classNode, std::ostream &out);
+
+    //! Returns `type` without const, pointer or reference qualifiers.
+    static polyglot::QualifiedType getUnqualifiedType(const polyglot::QualifiedType &type);
 };
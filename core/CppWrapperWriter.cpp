@@ -26,8 +26,6 @@ std::string CppWrapperWriter::getTypeString(const QualifiedType &type) const
     std::string typeString;
     if (type.isConst)
         typeString += "const ";
-    if (type.isReference)
-        typeString += "& ";
 
     switch (type.baseType)
     {
@@ -92,28 +90,97 @@ std::string CppWrapperWriter::getTypeString(const QualifiedType &type) const
         if (type.nameString.empty())
             throw std::runtime_error("Enum or class name was not provided to DWrapperWriter");
         else
-            typeString += type.nameString;
+            typeString += type.qualifiedName.empty() ? type.nameString : type.qualifiedName;
+        break;
+    case Type::Vector:
+        // The parser keeps the original spelling, since GNU vectors and ext_vector_type vectors don't convert implicitly.
+        if (!type.qualifiedName.empty())
+            typeString += type.qualifiedName;
+        else
+            typeString += std::format("{} __attribute__((vector_size({})))",
+                                      getTypeString(type.templateArguments.at(0)),
+                                      type.elementCount * Utils::getBuiltinTypeSize(type.templateArguments.at(0).baseType));
         break;
     case Type::CppStdString:
         typeString += "std::string";
         break;
+    case Type::CppStdVector:
+        typeString += (type.usesPolymorphicAllocator ? "std::pmr::vector<" : "std::vector<") +
+                      getTypeString(type.templateArguments.at(0)) + '>';
+        break;
+    case Type::CppStdMap:
+        typeString += (type.usesPolymorphicAllocator ? "std::pmr::map<" : "std::map<") +
+                      getTypeString(type.templateArguments.at(0)) + ", " + getTypeString(type.templateArguments.at(1)) +
+                      '>';
+        break;
+    case Type::CppStdUnorderedMap:
+        typeString += (type.usesPolymorphicAllocator ? "std::pmr::unordered_map<" : "std::unordered_map<") +
+                      getTypeString(type.templateArguments.at(0)) + ", " + getTypeString(type.templateArguments.at(1)) +
+                      '>';
+        break;
+    case Type::CppStdFunction:
+        typeString += "std::function<" + getSignatureString(type) + '>';
+        break;
+    case Type::CppStdFuture:
+        typeString += "std::future<" + getTypeString(type.templateArguments.at(0)) + '>';
+        break;
+    case Type::CppStdMemoryResource:
+        typeString += "std::pmr::memory_resource";
+        break;
+    case Type::CppStdUniquePtr:
+        typeString += "std::unique_ptr<" + getTypeString(type.templateArguments.at(0)) + '>';
+        break;
+    case Type::CppStdSharedPtr:
+        typeString += "std::shared_ptr<" + getTypeString(type.templateArguments.at(0)) + '>';
+        break;
+    case Type::CppStdOptional:
+        typeString += "std::optional<" + getTypeString(type.templateArguments.at(0)) + '>';
+        break;
+    case Type::FunctionPointer:
+        // Spelling it this way lets the type be followed by a name like any other type.
+        typeString += "std::add_pointer_t<" + getSignatureString(type) + '>';
+        break;
     case Type::Undefined:
         throw std::runtime_error("Undefined type in CppWrapperWriter::getTypeString()");
         break;
     }
 
+    if (!type.arrayExtents.empty())
+    {
+        std::string extents;
+        for (const auto extent : type.arrayExtents)
+            extents += std::format("[{}]", extent);
+
+        // Spelling it this way lets the type be followed by a name like any other type.
+        if (type.isArray)
+            return std::format("std::type_identity_t<{}{}{}>", typeString, type.isPointer ? " *" : "", extents);
+        typeString = std::format("std::type_identity_t<{}{}>", typeString, extents);
+    }
+
     if (type.isPointer)
         typeString += " *";
+    if (type.isReference)
+        typeString += " &";
+    if (type.isRvalueReference)
+        typeString += " &&";
 
     return typeString;
 }
 
+std::string CppWrapperWriter::getSignatureString(const QualifiedType &type) const
+{
+    std::string params;
+    for (auto it = type.templateArguments.cbegin() + 1; it != type.templateArguments.cend(); ++it)
+        params += getTypeString(*it) + ", ";
+    return getTypeString(type.templateArguments.at(0)) + '(' + params.substr(0, params.size() - 2) + ')';
+}
+
 std::string CppWrapperWriter::getValueString(const Value &value) const
 {
     switch (value.type)
     {
     case Type::Bool:
-        return std::to_string(std::get<bool>(value.value));
+        return std::get<bool>(value.value) ? "true" : "false";
         break;
     case Type::Char:
         return std::to_string(std::get<char>(value.value));
@@ -139,7 +206,7 @@ std::string CppWrapperWriter::getValueString(const Value &value) const
     case Type::Float32:
     case Type::Float64:
     case Type::Float128:
-        return std::to_string(std::get<double>(value.value));
+        return Utils::getFloatLiteral(std::get<double>(value.value));
         break;
     case Type::Enum:
     case Type::Class:
@@ -19,5 +19,8 @@ protected:
     friend class CppTypeProxyWriter;
 
 private:
+    //! Returns the function type (e.g. "int(float)") for a Type::FunctionPointer or Type::CppStdFunction.
+    std::string getSignatureString(const polyglot::QualifiedType &type) const;
+
     int16_t m_indentationDepth = 0;
 };
@@ -35,24 +35,48 @@ module {};
 // Polyglot wrapper file.
 import std.string: fromStringz, toStringz;
 import std.conv: to;
+import std.typecons: Tuple;
+import core.simd: Vector;
 )",
             Utils::POLYGLOT_VERSION,
             timeStr.substr(0, timeStr.size() - 1), // remove the '\n'
             Utils::getLanguageName(ast),
             ast.moduleName);
 
+        for (const auto &itemTypes : Utils::getIteratorItemTypes(ast))
+            writeIterator(itemTypes, out);
+        for (const auto &containerType : Utils::getContainerTypes(ast))
+        {
+            if (containerType.baseType == Type::CppStdVector)
+                writeVectorHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdFuture)
+                writeFutureHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdUniquePtr)
+                writeUniquePtrHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdSharedPtr)
+                writeSharedPtrHandle(containerType, out);
+            else
+                writeMapHandle(containerType, out);
+        }
+        for (const auto &optionalType : Utils::getOptionalTypes(ast))
+            writeOptional(optionalType, out);
+        if (Utils::hasMemoryResourceParameters(ast))
+            writeMemoryResource(out);
+
         if (ast.language == Language::Cpp)
             out << "\nextern(C++):\n";
     }
     ++s_onlyWriteHeaderOnce;
     out << "\n";
 
-    auto writeFunctionString = [this, &ast, &out](const polyglot::FunctionNode &function, bool isClassMethod, bool isProxied) {
+    auto writeFunctionString = [this, &out](const polyglot::FunctionNode &function, bool isClassMethod, bool isProxied) {
         out << std::string(m_indentationDepth, '\t');
         if (isProxied)
             out << "extern(D) ";
-        if (ast.language != Language::Cpp || isProxied)
-            out << std::format(R"(pragma(mangle, "{}") )", function.mangledName);
+        // D would mangle the binding names, which differ from the C++ ones for template specializations and anything
+        // that takes them, and it can't mangle rvalue references or std::optional at all. The mangled name is always
+        // known, so it is spelled out for every function.
+        out << std::format(R"(pragma(mangle, "{}") )", Utils::getSymbolName(function));
 
         if (isClassMethod && !function.isVirtual)
             out << "final ";
@@ -77,7 +101,17 @@ import std.conv: to;
                 params += " = " + getValueString(param.value.value());
             params += ", ";
         }
-        out << params.substr(0, params.size() - 2) + ");";
+        out << params.substr(0, params.size() - 2) + ')';
+
+        if (isClassMethod && function.isConst)
+            out << " const";
+        // C++ code never allocates from the D GC, so anything that can't throw is also @nogc. D's pure forbids reading
+        // global state, which only [[gnu::const]] rules out.
+        if (function.isNothrow)
+            out << " nothrow @nogc";
+        if (function.isConstFunction)
+            out << " pure";
+        out << ';';
         // TODO: am I missing any other qualifiers?
     };
     auto writeProxyFunction = [this, &ast, &out](const polyglot::FunctionNode &function) {
@@ -88,9 +122,10 @@ import std.conv: to;
 
         if (function.isNoreturn)
             out << "noreturn";
-        else if (function.typeProxy.isReturnProxied)
-            // For now we're assuming that the only thing being proxied is string types
+        else if (function.returnType.baseType == Type::CppStdString)
             out << "string";
+        else if (Utils::isContainerType(function.returnType.baseType))
+            out << Utils::getHandleName(function.returnType);
         else
             out << getTypeString(function.returnType);
         out << ' ' << function.functionName << '(';
@@ -98,10 +133,13 @@ import std.conv: to;
         std::string params;
         for (const auto &param : function.parameters)
         {
-            if (std::find(function.typeProxy.proxiedParameters.begin(),
-                                                        function.typeProxy.proxiedParameters.end(),
-                                                        param.name) != function.typeProxy.proxiedParameters.end())
+            if (param.type.baseType == Type::CppStdString)
                 params += "string";
+            else if (Utils::isContainerType(param.type.baseType))
+                // Only non-const references may be modified by C++; everything else is lent out read-only.
+                params += param.type.isReference && !param.type.isConst
+                              ? "ref " + Utils::getHandleName(param.type)
+                              : "ref const(" + Utils::getHandleName(param.type) + ')';
             else
                 params += getTypeString(param.type);
             params += ' ' + param.name;
@@ -115,27 +153,33 @@ import std.conv: to;
         if (function.returnType.baseType != Type::Void)
             out << "return ";
 
-        if (function.typeProxy.isReturnProxied)
+        if (function.returnType.baseType == Type::CppStdString)
             out << "to!string(fromStringz(";
+        else if (Utils::isContainerType(function.returnType.baseType) ||
+                 function.returnType.baseType == Type::CppStdUniquePtr)
+            out << Utils::getHandleName(function.returnType) << '(';
         out << function.typeProxy.proxy->functionName << '(';
 
         params.clear();
         for (const auto &param : function.parameters)
         {
-            const auto convertToStringz = std::find(function.typeProxy.proxiedParameters.begin(),
-                                                    function.typeProxy.proxiedParameters.end(),
-                                                    param.name) != function.typeProxy.proxiedParameters.end();
-            if (convertToStringz)
-                params += "toStringz(";
-            params += param.name;
-            if (convertToStringz)
-                params += ')';
+            if (param.type.baseType == Type::CppStdString)
+                params += "toStringz(" + param.name + ')';
+            else if (Utils::isContainerType(param.type.baseType))
+                params += param.name + ".ptr";
+            else if (param.type.baseType == Type::CppStdUniquePtr)
+                params += param.name + ".release()";
+            else
+                params += param.name;
             params += ", ";
         }
         out << params.substr(0, params.size() - 2);
 
-        if (function.typeProxy.isReturnProxied)
+        if (function.returnType.baseType == Type::CppStdString)
             out << "))";
+        else if (Utils::isContainerType(function.returnType.baseType) ||
+                 function.returnType.baseType == Type::CppStdUniquePtr)
+            out << ')';
         out << ");\n";
         out << std::string(--m_indentationDepth, '\t') << '}';
     };
@@ -173,7 +217,22 @@ import std.conv: to;
                 writeProxyFunction(*function);
             }
             else
-                writeFunctionString(*function, false, false);
+            {
+                // Functions that take std::function are bound through a shim that takes C callbacks instead.
+                const auto binding = Utils::getCallbackBinding(*function);
+                writeFunctionString(binding, false, false);
+                if (Utils::hasCallbackParameters(binding))
+                {
+                    out << "\n";
+                    writeCallbackFunction(binding, out);
+                }
+            }
+
+            if (function->isBatched)
+            {
+                out << "\n";
+                writeBatchFunction(*function, out);
+            }
         }
         else if (node->nodeType() == ASTNodeType::Enum)
         {
@@ -181,7 +240,10 @@ import std.conv: to;
             if (e == nullptr)
                 throw std::runtime_error("Node claimed to be EnumNode, but cast failed");
 
-            out << std::string(m_indentationDepth, '\t') << "enum " << e->enumName << '\n'
+            out << std::string(m_indentationDepth, '\t') << "enum " << e->enumName;
+            if (e->tagType.baseType != Type::Undefined)
+                out << " : " << getTypeString(e->tagType);
+            out << '\n'
                 << std::string(m_indentationDepth, '\t') << "{\n";
             for (const auto &enumerator : e->enumerators)
             {
@@ -192,14 +254,37 @@ import std.conv: to;
             }
             out << std::string(m_indentationDepth, '\t') << "}";
         }
+        else if (node->nodeType() == ASTNodeType::Variable)
+        {
+            auto variable = dynamic_cast<VariableNode *>(node);
+            if (variable == nullptr)
+                throw std::runtime_error("Node claimed to be VariableNode, but cast failed");
+
+            // __gshared refers to the C++ variable itself rather than a thread-local copy.
+            if (variable->isConstexpr)
+                out << std::string(m_indentationDepth, '\t') << getConstantString(*variable);
+            else
+                out << std::string(m_indentationDepth, '\t') << "extern __gshared " << getTypeString(variable->type) << ' '
+                    << variable->name << ';';
+        }
         else if (node->nodeType() == ASTNodeType::Class)
         {
             auto classNode = dynamic_cast<ClassNode *>(node);
             if (classNode == nullptr)
                 throw std::runtime_error("Node claimed to be ClassNode, but cast failed");
 
+            if (classNode->iteratorValueType)
+                writeClassIteratorHelpers(*classNode, out);
+
+            // D class instances live on the GC heap, so only classes that need D's virtual dispatch are bound as classes.
+            // Everything else becomes a struct, which can live on the stack or anywhere else the caller puts it.
+            const auto isDClass = isBoundAsClass(*classNode);
+
             out << std::string(m_indentationDepth, '\t');
-            if (classNode->type == polyglot::ClassNode::Type::Class)
+            // D classes are always references, so only the alignment of structs matters.
+            if (!isDClass && classNode->isExplicitlyAligned && classNode->alignment > 0)
+                out << std::format("align({}) ", classNode->alignment);
+            if (isDClass)
                 out << "class ";
             else
                 out << "struct ";
@@ -208,11 +293,27 @@ import std.conv: to;
                 << std::string(m_indentationDepth, '\t') << "public:\n";
 
             ++m_indentationDepth;
+            // Copying the bytes of a struct that isn't trivially copyable would skip its copy constructor.
+            if (!isDClass && classNode->size > 0 && !classNode->isTriviallyCopyable)
+                out << std::string(m_indentationDepth, '\t') << "@disable this(this);\n";
+            for (const auto &constant : classNode->constants)
+                out << std::string(m_indentationDepth, '\t') << getConstantString(constant) << '\n';
             for (const auto &constructor : classNode->constructors)
             {
+                // D has its own notion of copy and move constructors, which doesn't match C++'s.
+                if (Utils::isCopyConstructor(*classNode, constructor) || Utils::isMoveConstructor(*classNode, constructor))
+                    continue;
+
                 out << std::string(m_indentationDepth, '\t');
-                // TODO: figure out why C++ constructors don't mangle properly
-                out << std::format(R"(pragma(mangle, "{}") this()", constructor.mangledName);
+                // D structs can't have a default constructor, so the C++ one becomes a method that constructs the object
+                // in place.
+                if (!isDClass && constructor.parameters.empty())
+                {
+                    out << std::format(R"(pragma(mangle, "{}") void construct()", Utils::getSymbolName(constructor))
+                        << ");\n";
+                    continue;
+                }
+                out << std::format(R"(pragma(mangle, "{}") this()", Utils::getSymbolName(constructor));
                 std::string params;
                 for (const auto &param : constructor.parameters)
                 {
@@ -228,7 +329,7 @@ import std.conv: to;
             if (classNode->destructor.has_value())
             {
                 out << std::string(m_indentationDepth, '\t');
-                out << std::format(R"(pragma(mangle, "{}") )", classNode->destructor->mangledName);
+                out << std::format(R"(pragma(mangle, "{}") )", Utils::getSymbolName(*classNode->destructor));
                 out << "~this();\n";
             }
 
@@ -245,6 +346,8 @@ import std.conv: to;
             if (!classNode->members.empty())
             {
                 out << "\n";
+                if (classNode->packing > 0)
+                    out << std::string(m_indentationDepth, '\t') << std::format("align({}):\n", classNode->packing);
                 for (const auto &member : classNode->members)
                 {
                     out << std::string(m_indentationDepth, '\t') << getTypeString(member.type) + ' ' + member.name;
@@ -253,9 +356,13 @@ import std.conv: to;
                     out << ";\n";
                 }
             }
+
+            if (classNode->iteratorValueType)
+                writeClassIterator(*classNode, out);
             --m_indentationDepth;
 
             out << std::string(m_indentationDepth, '\t') << "}";
+            writeLayoutAssertions(*classNode, out);
         }
         out << "\n";
 
@@ -332,12 +439,36 @@ std::string DWrapperWriter::getTypeString(const QualifiedType &type) const
         else
             typeString += type.nameString;
         break;
+    case Type::Vector:
+        typeString += std::format("Vector!({}[{}])", getTypeString(type.templateArguments.at(0)), type.elementCount);
+        break;
     case Type::CppStdString:
         // D's support for std::strings is OK, but it requires some compiler tweaks to make it work right, so we'll ignore it
         // for now.
         typeString += "basic_string!char";
         // throw std::runtime_error("D std::string support is not enabled");
         break;
+    case Type::CppStdVector:
+    case Type::CppStdMap:
+    case Type::CppStdUnorderedMap:
+    case Type::CppStdFuture:
+    case Type::CppStdUniquePtr:
+    case Type::CppStdSharedPtr:
+    case Type::CppStdOptional:
+        typeString += Utils::getHandleName(type);
+        break;
+    case Type::CppStdMemoryResource:
+        // Memory resources are opaque; see PolyglotMemoryResource.ptr().
+        typeString += "void";
+        break;
+    case Type::CppStdFunction:
+        // std::function parameters are only bound through the callback and context pointer pair that the shim takes.
+        throw std::runtime_error("std::function can only be bound as a callback parameter");
+        break;
+    case Type::FunctionPointer:
+        // Declared in an extern(C++) scope, this gets C++ linkage, which uses the C calling convention.
+        typeString += getTypeString(type.templateArguments.at(0)) + " function" + getParameterListString(type.templateArguments);
+        break;
     case Type::Undefined:
         throw std::runtime_error("Undefined type in DWrapperWriter::getTypeString()");
         break;
@@ -346,21 +477,43 @@ std::string DWrapperWriter::getTypeString(const QualifiedType &type) const
     if (type.isConst)
         typeString = "const(" + typeString + ')';
 
-    if (type.isReference)
+    // D has no rvalue references, but a ref parameter is passed the same way. Like in C++, the object is left in its
+    // moved-from state and still gets destroyed by its owner.
+    if (type.isReference || type.isRvalueReference)
         typeString.insert(0, "ref ");
 
+    // D lists the extents of nested arrays innermost first. Array parameters are declared as the pointer to the first
+    // element that C++ adjusts them to, since that is what ends up in the mangled name.
+    std::string extents;
+    for (auto it = type.arrayExtents.crbegin(); it != type.arrayExtents.crend(); ++it)
+    {
+        if (type.isArray || it + 1 != type.arrayExtents.crend())
+            extents += std::format("[{}]", *it);
+    }
+    if (!type.isArray)
+        typeString += extents;
+
     if (type.isPointer)
         typeString += " *";
 
+    if (type.isArray)
+        typeString += extents;
+
     return typeString;
 }
 
+std::string DWrapperWriter::getConstantString(const VariableNode &constant) const
+{
+    // A manifest constant doesn't take up storage and is always folded into the code that uses it.
+    return std::format("enum {} {} = {};", getTypeString(constant.type), constant.name, getValueString(*constant.value));
+}
+
 std::string DWrapperWriter::getValueString(const Value &value) const
 {
     switch (value.type)
     {
     case Type::Bool:
-        return std::to_string(std::get<bool>(value.value));
+        return std::get<bool>(value.value) ? "true" : "false";
         break;
     case Type::Char:
         return std::to_string(std::get<char>(value.value));
@@ -386,7 +539,7 @@ std::string DWrapperWriter::getValueString(const Value &value) const
     case Type::Float32:
     case Type::Float64:
     case Type::Float128:
-        return std::to_string(std::get<double>(value.value));
+        return Utils::getFloatLiteral(std::get<double>(value.value));
         break;
     case Type::Enum:
     case Type::Class:
@@ -404,3 +557,594 @@ std::string DWrapperWriter::getValueString(const Value &value) const
         break;
     }
 }
+
+void DWrapperWriter::writeVectorHandle(const QualifiedType &vectorType, std::ostream &out) const
+{
+    out << std::format(R"(
+// Owning handle for a std::vector!{1} that lives in C++. Slicing it does not copy the elements, and the vector is freed
+// through C++ when the handle goes out of scope.
+struct {0}
+{{
+	private void *ptr;
+
+	@disable this(this);
+
+	~this()
+	{{
+		if (ptr)
+			{2}(ptr);
+	}}
+
+	static {0} fromSlice(const({1})[] data)
+	{{
+		return {0}({3}(data.ptr, data.length));
+	}}
+
+	inout({1})[] opSlice() inout
+	{{
+		const size = {5}(ptr);
+		if (size == 0)
+			return null;
+		return (cast(inout({1}) *) {4}(cast(void *) ptr))[0 .. size];
+	}}
+
+	alias opSlice this;
+}}
+
+extern(C) {1} *{4}(void *v);
+extern(C) size_t {5}(const(void) *v);
+extern(C) void {2}(void *v);
+extern(C) void *{3}(const({1}) *data, size_t size);
+)",
+                       Utils::getHandleName(vectorType),
+                       getTypeString(vectorType.templateArguments.at(0)),
+                       Utils::getHelperName(vectorType, "delete"),
+                       Utils::getHelperName(vectorType, "from"),
+                       Utils::getHelperName(vectorType, "data"),
+                       Utils::getHelperName(vectorType, "size"));
+}
+
+void DWrapperWriter::writeFutureHandle(const QualifiedType &futureType, std::ostream &out) const
+{
+    out << std::format(R"(
+// Owning handle for a std::future!{1} that lives in C++. Instead of blocking in get(), an event loop can register a
+// callback with onReady() that C++ calls once the result is ready, so a single thread can wait for any number of futures.
+// The future is freed through C++ when the handle goes out of scope.
+struct {0}
+{{
+	private void *ptr;
+
+	alias Callback = extern(C) void function(void *context);
+
+	@disable this(this);
+
+	~this()
+	{{
+		if (ptr)
+			{2}(ptr);
+	}}
+
+	bool ready() const
+	{{
+		return {3}(ptr);
+	}}
+
+	// The callback is called once, from a C++ thread, and must not use this handle.
+	void onReady(Callback callback, void *context) const
+	{{
+		{4}(ptr, callback, context);
+	}}
+
+	// Waits for the result if it isn't ready yet. This can only be called once.
+	{1} get()
+	{{
+		return {5}(ptr);
+	}}
+}}
+
+extern(C) bool {3}(const(void) *f);
+extern(C) void {4}(const(void) *f, {0}.Callback callback, void *context);
+extern(C) {1} {5}(void *f);
+extern(C) void {2}(void *f);
+)",
+                       Utils::getHandleName(futureType),
+                       getTypeString(futureType.templateArguments.at(0)),
+                       Utils::getHelperName(futureType, "delete"),
+                       Utils::getHelperName(futureType, "ready"),
+                       Utils::getHelperName(futureType, "notify"),
+                       Utils::getHelperName(futureType, "get"));
+}
+
+void DWrapperWriter::writeUniquePtrHandle(const QualifiedType &uniquePtrType, std::ostream &out) const
+{
+    auto pointerType = uniquePtrType.templateArguments.at(0);
+    pointerType.isPointer = true;
+    out << std::format(R"(
+// Owning handle for a std::unique_ptr!({1}). It is only the pointer, so it is passed to and from C++ as cheaply as a raw
+// one, and it frees the pointee through C++ when it goes out of scope. Pass it on with std.algorithm.move.
+struct {0}
+{{
+	private {2}ptr;
+
+	@disable this(this);
+
+	~this()
+	{{
+		if (ptr)
+			{3}(ptr);
+	}}
+
+	bool isNull() const
+	{{
+		return ptr is null;
+	}}
+
+	inout({2}) get() inout
+	{{
+		return ptr;
+	}}
+
+	// Gives up ownership of the pointee without freeing it.
+	{2}release()
+	{{
+		auto p = ptr;
+		ptr = null;
+		return p;
+	}}
+}}
+
+extern(C) void {3}({2}p) nothrow @nogc;
+)",
+                       Utils::getHandleName(uniquePtrType),
+                       getTypeString(uniquePtrType.templateArguments.at(0)),
+                       getTypeString(pointerType),
+                       Utils::getHelperName(uniquePtrType, "delete"));
+}
+
+void DWrapperWriter::writeSharedPtrHandle(const QualifiedType &sharedPtrType, std::ostream &out) const
+{
+    auto pointerType = sharedPtrType.templateArguments.at(0);
+    pointerType.isPointer = true;
+    out << std::format(R"(
+// Owning handle for a std::shared_ptr!({1}) that lives in C++. Copying it shares ownership like copying the shared_ptr
+// does. The handle keeps the pointee, so get() borrows it without touching the reference count; use it to pass the
+// pointee to functions that take a pointer or a reference. The shared_ptr is freed through C++ when the handle goes out
+// of scope.
+struct {0}
+{{
+	private void *ptr;
+	private {2}raw;
+
+	this(void *ptr)
+	{{
+		this.ptr = ptr;
+		raw = {3}(ptr);
+	}}
+
+	this(this)
+	{{
+		ptr = {4}(ptr);
+	}}
+
+	~this()
+	{{
+		if (ptr)
+			{5}(ptr);
+	}}
+
+	inout({2}) get() inout
+	{{
+		return raw;
+	}}
+}}
+
+extern(C) {2}{3}(const(void) *p) nothrow @nogc;
+extern(C) void *{4}(const(void) *p);
+extern(C) void {5}(void *p) nothrow @nogc;
+)",
+                       Utils::getHandleName(sharedPtrType),
+                       getTypeString(sharedPtrType.templateArguments.at(0)),
+                       getTypeString(pointerType),
+                       Utils::getHelperName(sharedPtrType, "get"),
+                       Utils::getHelperName(sharedPtrType, "clone"),
+                       Utils::getHelperName(sharedPtrType, "delete"));
+}
+
+void DWrapperWriter::writeOptional(const QualifiedType &optionalType, std::ostream &out) const
+{
+    out << std::format(R"(
+// A std::optional!({1}). It has the same layout, so it is passed by value without any conversion. Its .init value is
+// empty.
+struct {0}
+{{
+	private {1} value;
+	private bool engaged;
+
+	this({1} value)
+	{{
+		this.value = value;
+		engaged = true;
+	}}
+
+	bool hasValue() const
+	{{
+		return engaged;
+	}}
+
+	ref inout({1}) get() inout
+	{{
+		assert(engaged, "{0} is empty");
+		return value;
+	}}
+}}
+)",
+                       Utils::getHandleName(optionalType),
+                       getTypeString(optionalType.templateArguments.at(0)));
+}
+
+void DWrapperWriter::writeMemoryResource(std::ostream &out) const
+{
+    out << R"(
+// A std::pmr::memory_resource that allocates from a D allocator (e.g. a Region), for functions that take a
+// std::pmr::memory_resource *. The allocator has to outlive the resource and everything that C++ allocated from it.
+struct PolyglotMemoryResource
+{
+	private void *resource;
+
+	@disable this(this);
+
+	~this()
+	{
+		if (resource)
+			polyglot_memory_resource_delete(resource);
+	}
+
+	static PolyglotMemoryResource create(Allocator)(ref Allocator allocator)
+	{
+		static extern(C) void *allocate(void *context, size_t size, size_t alignment)
+		{
+			auto a = cast(Allocator *) context;
+			static if (__traits(hasMember, Allocator, "alignedAllocate"))
+				return a.alignedAllocate(size, cast(uint) alignment).ptr;
+			else
+				return alignment <= a.alignment ? a.allocate(size).ptr : null;
+		}
+		static extern(C) void deallocate(void *context, void *p, size_t size, size_t alignment)
+		{
+			static if (__traits(hasMember, Allocator, "deallocate"))
+				(cast(Allocator *) context).deallocate(p[0 .. size]);
+		}
+		return PolyglotMemoryResource(polyglot_memory_resource_new(&allocate, &deallocate, cast(void *) &allocator));
+	}
+
+	void *ptr()
+	{
+		return resource;
+	}
+}
+
+extern(C) void *polyglot_memory_resource_new(void *function(void *, size_t, size_t) allocate, void function(void *, void *, size_t, size_t) deallocate, void *context);
+extern(C) void polyglot_memory_resource_delete(void *resource);
+)";
+}
+
+void DWrapperWriter::writeMapHandle(const QualifiedType &mapType, std::ostream &out) const
+{
+    out << std::format(R"(
+// Owning handle for a {1}!({2}, {3}) that lives in C++. Its entries can be iterated over in chunks, and the map is freed
+// through C++ when the handle goes out of scope.
+struct {0}
+{{
+	private void *ptr;
+
+	@disable this(this);
+
+	~this()
+	{{
+		if (ptr)
+			{8}(ptr);
+	}}
+
+	static {0} create()
+	{{
+		return {0}({5}());
+	}}
+
+	size_t length() const
+	{{
+		return {6}(ptr);
+	}}
+
+	void insert({2} key, {3} value)
+	{{
+		{7}(ptr, key, value);
+	}}
+
+	{4} iter(size_t chunkSize) const
+	{{
+		return {4}({9}(ptr), &{10}, &{11}, chunkSize);
+	}}
+}}
+
+extern(C) void *{5}();
+extern(C) size_t {6}(const(void) *m);
+extern(C) void {7}(void *m, {2} key, {3} value);
+extern(C) void {8}(void *m);
+extern(C) void *{9}(const(void) *m);
+extern(C) size_t {10}(void *state, {2} *keys, {3} *values, size_t capacity);
+extern(C) void {11}(void *state);
+)",
+                       Utils::getHandleName(mapType),
+                       mapType.baseType == Type::CppStdMap ? "std.map" : "std.unordered_map",
+                       getTypeString(mapType.templateArguments.at(0)),
+                       getTypeString(mapType.templateArguments.at(1)),
+                       Utils::getIteratorName(mapType.templateArguments),
+                       Utils::getHelperName(mapType, "new"),
+                       Utils::getHelperName(mapType, "size"),
+                       Utils::getHelperName(mapType, "insert"),
+                       Utils::getHelperName(mapType, "delete"),
+                       Utils::getHelperName(mapType, "iter_begin"),
+                       Utils::getHelperName(mapType, "iter_next"),
+                       Utils::getHelperName(mapType, "iter_free"));
+}
+
+void DWrapperWriter::writeIterator(const std::vector<QualifiedType> &itemTypes, std::ostream &out) const
+{
+    std::string itemType;
+    std::string bufferPointerTypes;
+    std::string bufferFields;
+    std::string bufferInits;
+    std::string bufferArgs;
+    std::string item;
+    for (size_t i = 0; i < itemTypes.size(); ++i)
+    {
+        const auto type = getTypeString(itemTypes[i]);
+        bufferPointerTypes += type + " *, ";
+        bufferFields += std::format("\tprivate {}[] buffer{};\n", type, i);
+        bufferInits += std::format("\t\tbuffer{} = new {}[chunkSize ? chunkSize : 1];\n", i, type);
+        bufferArgs += std::format("buffer{}.ptr, ", i);
+        item += std::format("buffer{}[position], ", i);
+    }
+    item = item.substr(0, item.size() - 2);
+    if (itemTypes.size() == 2)
+    {
+        itemType = std::format(R"(Tuple!({}, "key", {}, "value"))",
+                               getTypeString(itemTypes[0]),
+                               getTypeString(itemTypes[1]));
+        item = itemType + '(' + item + ')';
+    }
+    else
+        itemType = getTypeString(itemTypes.at(0));
+
+    out << std::format(R"(
+// Input range over a C++ container that copies up to `chunkSize` items out of C++ per boundary crossing.
+struct {0}
+{{
+	alias NextChunk = extern(C) size_t function(void *, {2}size_t);
+	alias Free = extern(C) void function(void *);
+
+	private void *state;
+	private NextChunk nextChunk;
+	private Free free;
+{3}	private size_t position;
+	private size_t length;
+
+	@disable this(this);
+
+	this(void *state, NextChunk nextChunk, Free free, size_t chunkSize)
+	{{
+		this.state = state;
+		this.nextChunk = nextChunk;
+		this.free = free;
+{4}		fetch();
+	}}
+
+	~this()
+	{{
+		if (state)
+			free(state);
+	}}
+
+	bool empty() const
+	{{
+		return position == length;
+	}}
+
+	{1} front()
+	{{
+		return {6};
+	}}
+
+	void popFront()
+	{{
+		if (++position == length)
+			fetch();
+	}}
+
+	private void fetch()
+	{{
+		position = 0;
+		length = state ? nextChunk(state, {5}buffer0.length) : 0;
+		if (length == 0 && state)
+		{{
+			free(state);
+			state = null;
+		}}
+	}}
+}}
+)",
+                       Utils::getIteratorName(itemTypes),
+                       itemType,
+                       bufferPointerTypes,
+                       bufferFields,
+                       bufferInits,
+                       bufferArgs,
+                       item);
+}
+
+void DWrapperWriter::writeClassIteratorHelpers(const ClassNode &classNode, std::ostream &out) const
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent << std::format("extern(C) void *{}(void *c);\n", Utils::getClassHelperName(classNode, "iter_begin"))
+        << indent << std::format("extern(C) size_t {}(void *state, {} *values, size_t capacity);\n",
+                                 Utils::getClassHelperName(classNode, "iter_next"),
+                                 getTypeString(*classNode.iteratorValueType))
+        << indent << std::format("extern(C) void {}(void *state);\n", Utils::getClassHelperName(classNode, "iter_free"))
+        << '\n';
+}
+
+void DWrapperWriter::writeClassIterator(const ClassNode &classNode, std::ostream &out) const
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+    const auto iterator = Utils::getIteratorName({*classNode.iteratorValueType});
+    const auto isClass = isBoundAsClass(classNode);
+
+    out << '\n'
+        << indent << "extern(D) " << (isClass ? "final " : "") << iterator << " iter(size_t chunkSize)\n"
+        << indent << "{\n"
+        << indent << std::format("\treturn {}({}({}), &{}, &{}, chunkSize);\n",
+                                 iterator,
+                                 Utils::getClassHelperName(classNode, "iter_begin"),
+                                 isClass ? "cast(void *) this" : "&this",
+                                 Utils::getClassHelperName(classNode, "iter_next"),
+                                 Utils::getClassHelperName(classNode, "iter_free"))
+        << indent << "}\n";
+}
+
+void DWrapperWriter::writeCallbackFunction(const polyglot::FunctionNode &function, std::ostream &out)
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+
+    std::string params;
+    std::string args;
+    std::string trampolines;
+    for (size_t i = 0; i < function.parameters.size(); ++i)
+    {
+        const auto &param = function.parameters[i];
+        if (!Utils::isCallbackParameter(function, i))
+        {
+            params += getTypeString(param.type) + ' ' + param.name + ", ";
+            args += param.name + ", ";
+            continue;
+        }
+
+        // The delegate is taken by reference and its address is passed as the context, so it must stay alive for as long
+        // as C++ may call it. The trampoline has C++ linkage to match the function pointer type.
+        auto signature = param.type.templateArguments;
+        signature.pop_back();
+        const auto delegate = getTypeString(signature.front()) + " delegate" + getParameterListString(signature);
+        params += "ref " + delegate + ' ' + param.name + ", ";
+        args += std::format("&trampoline{}, cast(void *) &{}, ", i, param.name);
+
+        std::string trampolineParams;
+        std::string trampolineArgs;
+        for (size_t j = 1; j < signature.size(); ++j)
+        {
+            trampolineParams += std::format("{} a{}, ", getTypeString(signature[j]), j - 1);
+            trampolineArgs += std::format("a{}, ", j - 1);
+        }
+        trampolines += indent + std::format("\tstatic extern(C++) {} trampoline{}({}void *context)\n",
+                                            getTypeString(signature.front()),
+                                            i,
+                                            trampolineParams) +
+                       indent + "\t{\n" + indent + "\t\treturn (*cast(" + delegate + " *) context)(" +
+                       trampolineArgs.substr(0, trampolineArgs.size() - 2) + ");\n" + indent + "\t}\n";
+        ++i; // The context pointer is filled in by the wrapper.
+    }
+
+    out << indent << "extern(D) " << getTypeString(function.returnType) << ' ' << function.functionName << '('
+        << params.substr(0, params.size() - 2) << ")\n"
+        << indent << "{\n"
+        << trampolines
+        << indent << "\treturn " << function.functionName << '(' << args.substr(0, args.size() - 2) << ");\n"
+        << indent << '}';
+}
+
+std::string DWrapperWriter::getParameterListString(const std::vector<polyglot::QualifiedType> &signature) const
+{
+    std::string params;
+    for (auto it = signature.cbegin() + 1; it != signature.cend(); ++it)
+        params += getTypeString(*it) + ", ";
+    return '(' + params.substr(0, params.size() - 2) + ')';
+}
+
+void DWrapperWriter::writeBatchFunction(const FunctionNode &function, std::ostream &out)
+{
+    const auto hasResults = function.returnType.baseType != Type::Void;
+    const auto externName = function.functionName + "_polyglot_batch";
+    // All arrays have to be as long as the first one; with results, that's the results array.
+    const auto countSource = hasResults ? std::string{"results"} : function.parameters.at(0).name;
+
+    std::string externParams;
+    std::string params;
+    std::string checks;
+    std::string args;
+    for (const auto &param : function.parameters)
+    {
+        externParams += "const(" + getTypeString(param.type) + ") *" + param.name + ", ";
+        params += "const(" + getTypeString(param.type) + ")[] " + param.name + ", ";
+        if (param.name != countSource)
+            checks += param.name + ".length == " + countSource + ".length && ";
+        args += param.name + ".ptr, ";
+    }
+    if (hasResults)
+    {
+        externParams += getTypeString(function.returnType) + " *results, ";
+        params += getTypeString(function.returnType) + "[] results, ";
+        args += "results.ptr, ";
+    }
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent
+        << std::format(R"(extern(C) pragma(mangle, "{}") void {}({}size_t count);)",
+                       Utils::getBatchSymbolName(function),
+                       externName,
+                       externParams)
+        << '\n';
+
+    // Calls the function once for each set of arguments, crossing into C++ only once for the whole batch.
+    out << indent << "extern(D) void " << function.functionName << "_batch(" << params.substr(0, params.size() - 2)
+        << ")\n"
+        << indent << "{\n";
+    if (!checks.empty())
+        out << indent << "\tassert(" << checks.substr(0, checks.size() - 4)
+            << std::format(R"(, "All batch arrays passed to {}_batch must have the same length");)", function.functionName)
+            << '\n';
+    out << indent << '\t' << externName << '(' << args << countSource << ".length);\n"
+        << indent << '}';
+}
+
+bool DWrapperWriter::isBoundAsClass(const ClassNode &classNode)
+{
+    // Without a layout, it isn't known whether the class is polymorphic, so the C++ keyword is the best guess.
+    if (classNode.size == 0)
+        return classNode.type == ClassNode::Type::Class;
+    return classNode.isPolymorphic;
+}
+
+void DWrapperWriter::writeLayoutAssertions(const ClassNode &classNode, std::ostream &out) const
+{
+    // D always gives extern(C++) classes a vtable pointer, so only structs can be expected to match the C++ layout.
+    if (classNode.size == 0 || classNode.members.empty() || isBoundAsClass(classNode))
+        return;
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << "\n"
+        << indent << std::format(R"(static assert({0}.sizeof == {1}, "size of {0} does not match C++");)", classNode.name, classNode.size)
+        << '\n'
+        << indent
+        << std::format(R"(static assert({0}.alignof == {1}, "alignment of {0} does not match C++");)",
+                       classNode.name,
+                       classNode.alignment);
+    for (const auto &member : classNode.members)
+    {
+        if (!member.offset)
+            continue;
+        out << '\n'
+            << indent
+            << std::format(R"(static assert({0}.{1}.offsetof == {2}, "offset of {0}.{1} does not match C++");)",
+                           classNode.name,
+                           member.name,
+                           *member.offset);
+    }
+}
@@ -18,5 +18,36 @@ protected:
     std::string getValueString(const polyglot::Value &value) const final;
 
 private:
+    void writeVectorHandle(const polyglot::QualifiedType &vectorType, std::ostream &out) const;
+    void writeMapHandle(const polyglot::QualifiedType &mapType, std::ostream &out) const;
+    void writeFutureHandle(const polyglot::QualifiedType &futureType, std::ostream &out) const;
+    void writeUniquePtrHandle(const polyglot::QualifiedType &uniquePtrType, std::ostream &out) const;
+    void writeSharedPtrHandle(const polyglot::QualifiedType &sharedPtrType, std::ostream &out) const;
+    void writeOptional(const polyglot::QualifiedType &optionalType, std::ostream &out) const;
+    void writeMemoryResource(std::ostream &out) const;
+    void writeIterator(const std::vector<polyglot::QualifiedType> &itemTypes, std::ostream &out) const;
+    //! Declares the C helpers behind writeClassIterator(); these have to be written before the class itself.
+    void writeClassIteratorHelpers(const polyglot::ClassNode &classNode, std::ostream &out) const;
+    //! Writes an iter() method for a class that can be iterated over with begin() and end().
+    void writeClassIterator(const polyglot::ClassNode &classNode, std::ostream &out) const;
+
+    //! Returns the definition of a compile-time constant.
+    std::string getConstantString(const polyglot::VariableNode &constant) const;
+
+    //! Whether `classNode` is bound as a D class rather than a struct. Only polymorphic classes need to be D classes.
+    static bool isBoundAsClass(const polyglot::ClassNode &classNode);
+
+    //! Writes compile-time assertions that the struct generated for `classNode` has the same layout as the C++ class.
+    void writeLayoutAssertions(const polyglot::ClassNode &classNode, std::ostream &out) const;
+    //! Writes the slice-based wrapper for a function annotated with "polyglot::batch".
+    void writeBatchFunction(const polyglot::FunctionNode &function, std::ostream &out);
+    //! Writes an overload for a function that takes callbacks (see Utils::hasCallbackParameters()), which takes a
+    //! delegate for each callback and context pair of `function`. `function` has to be the declaration returned by
+    //! Utils::getCallbackBinding().
+    void writeCallbackFunction(const polyglot::FunctionNode &function, std::ostream &out);
+    //! Returns the parameter list of a function type (e.g. "(int, double)"). `signature` holds the return type followed
+    //! by the parameter types.
+    std::string getParameterListString(const std::vector<polyglot::QualifiedType> &signature) const;
+
     int16_t m_indentationDepth = 0;
 };
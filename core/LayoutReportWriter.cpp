@@ -0,0 +1,220 @@
+// SPDX-FileCopyrightText: Loren Burkholder
+//
+// SPDX-License-Identifier: GPL-3.0
+
+#include "LayoutReportWriter.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+using namespace polyglot;
+
+static uint64_t alignTo(uint64_t value, uint64_t alignment)
+{
+    if (alignment <= 1)
+        return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static std::string join(const std::vector<std::string> &list, const std::string &separator)
+{
+    std::string ret;
+    for (const auto &item : list)
+        ret += (ret.empty() ? "" : separator) + item;
+    return ret;
+}
+
+void LayoutReportWriter::write(const std::vector<const polyglot::AST *> &asts, std::ostream &out) const
+{
+    std::vector<ClassReport> reports;
+    for (const auto ast : asts)
+        collectReports(*ast, ast->moduleName, reports);
+
+    if (m_format == Format::Json)
+        writeJson(reports, out);
+    else
+        writeText(reports, out);
+    out.flush();
+}
+
+void LayoutReportWriter::collectReports(const polyglot::AST &ast,
+                                        const std::string &moduleName,
+                                        std::vector<ClassReport> &reports)
+{
+    for (const auto node : ast.nodes)
+    {
+        if (node->nodeType() == ASTNodeType::Namespace)
+        {
+            auto ns = dynamic_cast<const NamespaceNode *>(node);
+            if (ns == nullptr)
+                throw std::runtime_error("Node claimed to be NamespaceNode, but cast failed");
+            collectReports(ns->ast, moduleName, reports);
+        }
+        else if (node->nodeType() == ASTNodeType::Class)
+        {
+            auto classNode = dynamic_cast<const ClassNode *>(node);
+            if (classNode == nullptr)
+                throw std::runtime_error("Node claimed to be ClassNode, but cast failed");
+
+            // Forward declarations don't have a layout.
+            if (classNode->size > 0)
+                reports.push_back(analyze(*classNode, moduleName));
+        }
+    }
+}
+
+LayoutReportWriter::ClassReport LayoutReportWriter::analyze(const polyglot::ClassNode &classNode,
+                                                            const std::string &moduleName)
+{
+    ClassReport report;
+    report.moduleName = moduleName;
+    report.classNode = &classNode;
+
+    for (const auto &member : classNode.members)
+    {
+        if (member.offset)
+            report.members.push_back(&member);
+        else
+            report.isComplete = false;
+    }
+    std::stable_sort(report.members.begin(), report.members.end(), [](const auto a, const auto b) {
+        return *a->offset < *b->offset;
+    });
+
+    for (const auto member : report.members)
+    {
+        const auto offset = *member->offset;
+        if (member->size > 0 && offset / CACHE_LINE_SIZE != (offset + member->size - 1) / CACHE_LINE_SIZE)
+            report.straddlingMembers.push_back(member->name);
+    }
+
+    if (!report.isComplete || report.members.empty())
+        return report;
+
+    // Anything before the first member belongs to base classes or the vtable pointer, so it isn't counted as padding.
+    const auto start = *report.members.front()->offset;
+    auto end = start;
+    for (const auto member : report.members)
+    {
+        if (*member->offset > end)
+            report.holes.push_back({end, *member->offset - end});
+        end = std::max(end, *member->offset + member->size);
+    }
+    if (classNode.size > end)
+        report.holes.push_back({end, classNode.size - end});
+    for (const auto &hole : report.holes)
+        report.padding += hole.size;
+
+    // Ordering the members by decreasing alignment is enough to remove all padding between them. The sort is stable, so
+    // members with the same alignment keep their relative order.
+    auto suggested = report.members;
+    std::stable_sort(suggested.begin(), suggested.end(), [](const auto a, const auto b) {
+        return a->alignment > b->alignment;
+    });
+    auto position = start;
+    for (const auto member : suggested)
+        position = alignTo(position, member->alignment) + member->size;
+    const auto suggestedSize = alignTo(position, classNode.alignment);
+    if (suggestedSize < classNode.size)
+    {
+        report.suggestedSize = suggestedSize;
+        for (const auto member : suggested)
+            report.suggestedOrder.push_back(member->name);
+    }
+
+    return report;
+}
+
+void LayoutReportWriter::writeText(const std::vector<ClassReport> &reports, std::ostream &out)
+{
+    for (const auto &report : reports)
+    {
+        const auto &classNode = *report.classNode;
+        out << std::format("{} (module {}): {} bytes, aligned to {}",
+                           classNode.qualifiedName,
+                           report.moduleName,
+                           classNode.size,
+                           classNode.alignment);
+        if (report.isComplete)
+            out << std::format(", {} bytes of padding", report.padding);
+        out << '\n';
+
+        // Print the members and the holes between them in layout order.
+        out << std::format("  {:>8} {:>8}  member\n", "offset", "size");
+        auto hole = report.holes.cbegin();
+        for (const auto member : report.members)
+        {
+            for (; hole != report.holes.cend() && hole->offset < *member->offset; ++hole)
+                out << std::format("  {:>8} {:>8}  <padding>\n", hole->offset, hole->size);
+            out << std::format("  {:>8} {:>8}  {}\n", *member->offset, member->size, member->name);
+        }
+        for (; hole != report.holes.cend(); ++hole)
+            out << std::format("  {:>8} {:>8}  <padding>\n", hole->offset, hole->size);
+
+        if (!report.isComplete)
+            out << "  padding was not analyzed because some members (e.g. bit-fields) have no byte offset\n";
+        if (!report.straddlingMembers.empty())
+            out << std::format("  members crossing a {}-byte cache line: {}\n",
+                               CACHE_LINE_SIZE,
+                               join(report.straddlingMembers, ", "));
+        if (!report.suggestedOrder.empty())
+            out << std::format("  suggested member order: {} ({} bytes)\n",
+                               join(report.suggestedOrder, ", "),
+                               report.suggestedSize);
+        out << '\n';
+    }
+}
+
+void LayoutReportWriter::writeJson(const std::vector<ClassReport> &reports, std::ostream &out)
+{
+    // Names are C++ identifiers, so they never need escaping.
+    auto quote = [](const std::string &s) {
+        return '"' + s + '"';
+    };
+    auto quoteAll = [&quote](const std::vector<std::string> &list) {
+        std::vector<std::string> ret;
+        for (const auto &item : list)
+            ret.push_back(quote(item));
+        return ret;
+    };
+
+    out << "{\n\t\"cacheLineSize\": " << CACHE_LINE_SIZE << ",\n\t\"classes\": [";
+    for (size_t i = 0; i < reports.size(); ++i)
+    {
+        const auto &report = reports[i];
+        const auto &classNode = *report.classNode;
+
+        std::vector<std::string> members;
+        for (const auto member : report.members)
+            members.push_back(std::format(R"({{"name": "{}", "offset": {}, "size": {}, "alignment": {}}})",
+                                          member->name,
+                                          *member->offset,
+                                          member->size,
+                                          member->alignment));
+        std::vector<std::string> holes;
+        for (const auto &hole : report.holes)
+            holes.push_back(std::format(R"({{"offset": {}, "size": {}}})", hole.offset, hole.size));
+
+        out << (i > 0 ? "," : "") << "\n\t\t{\n"
+            << std::format("\t\t\t\"name\": {},\n", quote(classNode.qualifiedName))
+            << std::format("\t\t\t\"module\": {},\n", quote(report.moduleName))
+            << std::format("\t\t\t\"size\": {},\n", classNode.size)
+            << std::format("\t\t\t\"alignment\": {},\n", classNode.alignment)
+            << std::format("\t\t\t\"members\": [{}],\n", join(members, ", "));
+        if (report.isComplete)
+            out << std::format("\t\t\t\"padding\": {},\n", report.padding)
+                << std::format("\t\t\t\"holes\": [{}],\n", join(holes, ", "));
+        else
+            out << "\t\t\t\"padding\": null,\n\t\t\t\"holes\": null,\n";
+        out << std::format("\t\t\t\"cacheLineStraddles\": [{}],\n", join(quoteAll(report.straddlingMembers), ", "));
+        if (report.suggestedOrder.empty())
+            out << "\t\t\t\"suggestedOrder\": null\n";
+        else
+            out << std::format("\t\t\t\"suggestedOrder\": {{\"members\": [{}], \"size\": {}}}\n",
+                               join(quoteAll(report.suggestedOrder), ", "),
+                               report.suggestedSize);
+        out << "\t\t}";
+    }
+    out << (reports.empty() ? "" : "\n\t") << "]\n}\n";
+}
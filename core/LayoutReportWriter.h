@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: Loren Burkholder
+//
+// SPDX-License-Identifier: GPL-3.0
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PolyglotAST.h"
+
+//! Writes a report about the memory layout of every class in a set of ASTs: the size and alignment, padding holes, members
+//! that straddle a cache line and a member order that would need less padding.
+class LayoutReportWriter
+{
+public:
+    enum class Format
+    {
+        Text,
+        Json,
+    };
+
+    explicit LayoutReportWriter(Format format)
+        : m_format{format}
+    {}
+
+    void write(const std::vector<const polyglot::AST *> &asts, std::ostream &out) const;
+
+    //! The cache line size that members are checked against.
+    static constexpr uint64_t CACHE_LINE_SIZE = 64;
+
+private:
+    struct Hole
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct ClassReport
+    {
+        std::string moduleName;
+        const polyglot::ClassNode *classNode;
+        //! The members with a known offset, ordered by offset.
+        std::vector<const polyglot::VariableNode *> members;
+        std::vector<Hole> holes;
+        uint64_t padding = 0;
+        std::vector<std::string> straddlingMembers;
+        //! Whether every member has a known offset. Padding can't be analyzed otherwise (e.g. with bit-fields).
+        bool isComplete = true;
+        //! A member order that needs less padding, or empty if the current order is already as small as it gets.
+        std::vector<std::string> suggestedOrder;
+        uint64_t suggestedSize = 0;
+    };
+
+    static void collectReports(const polyglot::AST &ast, const std::string &moduleName, std::vector<ClassReport> &reports);
+    static ClassReport analyze(const polyglot::ClassNode &classNode, const std::string &moduleName);
+
+    static void writeText(const std::vector<ClassReport> &reports, std::ostream &out);
+    static void writeJson(const std::vector<ClassReport> &reports, std::ostream &out);
+
+    Format m_format;
+};
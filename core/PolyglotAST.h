@@ -83,8 +83,25 @@ namespace polyglot
         Enum,
         Class,
 
+        // A SIMD vector (e.g. __m128). The element type is stored in the template arguments of QualifiedType and the
+        // number of lanes in QualifiedType::elementCount.
+        Vector,
+
         // Types that are known to need indirect bindings (at least in some cases)
         CppStdString,
+        CppStdVector,
+        CppStdMap,
+        CppStdUnorderedMap,
+        CppStdFunction,
+        CppStdFuture,
+        CppStdMemoryResource,
+        // The pointee or value type is stored in the template arguments of QualifiedType.
+        CppStdUniquePtr,
+        CppStdSharedPtr,
+        CppStdOptional,
+
+        // A pointer to a function. The signature is stored in the template arguments of QualifiedType.
+        FunctionPointer,
 
         Undefined,
     };
@@ -148,7 +165,7 @@ namespace polyglot
         //! Whether the type is volatile.
         bool isVolatile = false;
 
-        //! Whether the type is an array.
+        //! Whether the type is an array. The other fields describe its elements, and arrayExtents holds its size.
         bool isArray = false;
 
         //! Whether the type is a reference.
@@ -160,6 +177,26 @@ namespace polyglot
         //! This is only set if baseType is equal to Type::Class or Type::Enum.
         std::string nameString;
 
+        //! For Type::Class and Type::Enum, the name that generated C++ code uses for the type, including namespaces and
+        //! template arguments (e.g. "ns::Vec<float>"). If it is empty, nameString is used.
+        std::string qualifiedName;
+
+        //! For template types like Type::CppStdVector, this holds the template arguments (e.g. the element type). For
+        //! Type::FunctionPointer and Type::CppStdFunction, it holds the signature: the return type followed by the
+        //! parameter types.
+        std::vector<QualifiedType> templateArguments;
+
+        //! For standard library containers, whether they use std::pmr::polymorphic_allocator (e.g. std::pmr::vector), so
+        //! that they allocate from a std::pmr::memory_resource instead of the global heap.
+        bool usesPolymorphicAllocator = false;
+
+        //! For Type::Vector, the number of lanes.
+        uint64_t elementCount = 0;
+
+        //! For arrays, the number of elements in each dimension, outermost first (e.g. {4, 3} for `float[4][3]`). If this
+        //! is set but isArray isn't, the type is a pointer to such an array, which is how array parameters are passed.
+        std::vector<uint64_t> arrayExtents;
+
         bool operator==(const QualifiedType &other) const = default;
     };
 
@@ -189,6 +226,27 @@ namespace polyglot
 
         //! If the variable has a value set (e.g. a default argument for a function parameter), this holds that value.
         std::optional<Value> value;
+
+        //! If the variable is a class member, this holds its offset in bytes from the start of the class (as laid out by
+        //! the source language's compiler). Bit-fields don't have a byte offset.
+        std::optional<uint64_t> offset;
+
+        //! The size of the variable's type in bytes, or 0 if it is not known. This is only filled in for class members.
+        uint64_t size = 0;
+
+        //! The alignment of the variable's type in bytes, or 0 if it is not known. This is only filled in for class members.
+        uint64_t alignment = 0;
+
+        //! If the variable is a global variable, this holds its symbol name.
+        std::string mangledName;
+
+        //! If the variable is a global variable, whether it is inline, so that a translation unit only emits its symbol if
+        //! it uses the variable.
+        bool isInline = false;
+
+        //! Whether the variable is a compile-time constant. Its value is stored in `value`, and the bindings define the
+        //! constant themselves instead of referring to a symbol.
+        bool isConstexpr = false;
     };
 
     //! Represents a function.
@@ -202,6 +260,10 @@ namespace polyglot
         //! This contains what the function will be mangled to by the compiler.
         std::string mangledName;
 
+        //! The name that generated C++ code calls the function by if it differs from functionName, e.g. "dot<float>" for
+        //! a function template specialization that the bindings call "dot_float".
+        std::string cppName;
+
         //! The return type of the function.
         QualifiedType returnType;
 
@@ -209,22 +271,51 @@ namespace polyglot
         std::vector<VariableNode> parameters;
 
         //! Whether the function is marked noreturn.
-        bool isNoreturn;
+        bool isNoreturn = false;
 
         //! Whether the function is guaranteed to not throw exceptions.
-        bool isNothrow;
+        bool isNothrow = false;
+
+        //! Whether the function is marked `[[gnu::pure]]`, i.e. it has no side effects, but its result may depend on global
+        //! memory as well as its parameters.
+        bool isPure = false;
+
+        //! Whether the function is marked `[[gnu::const]]`, i.e. it has no side effects and its result only depends on its
+        //! parameters. This is a stronger guarantee than isPure.
+        bool isConstFunction = false;
 
         //! If the function is part of a class, whether the function is static.
-        bool isStatic;
+        bool isStatic = false;
+
+        //! If the function is part of a class, whether the function is a const member function.
+        bool isConst = false;
 
         //! If the function is part of a class, whether the function is virtual.
-        bool isVirtual;
+        bool isVirtual = false;
 
         //! If the function is part of a class, whether the function is marked override.
-        bool isOverride;
+        bool isOverride = false;
 
         //! If the function is part of a class, whether the function is marked final.
-        bool isFinal;
+        bool isFinal = false;
+
+        //! If the function is a virtual method, this holds its slot in the class's vtable (counted in pointers from the
+        //! address point that the object's vtable pointer points to).
+        std::optional<uint64_t> vtableIndex;
+
+        //! Whether the function is inline (explicitly, through constexpr or by being defined in a class body) or otherwise
+        //! not guaranteed to emit a symbol. Bindings for such functions go through an out-of-line shim instead.
+        bool isInline = false;
+
+        //! Whether the function returns a class by value that isn't trivially copyable. C++ returns such objects through a
+        //! hidden pointer to storage provided by the caller, so the bindings reserve that storage themselves and call a shim
+        //! that constructs the result directly in it.
+        bool hasReturnSlot = false;
+
+        //! Whether the function is annotated with `[[clang::annotate("polyglot::batch")]]`. Batched functions get an extra
+        //! entry point that calls them once for every element of parallel argument arrays, so that a whole batch of calls
+        //! only has to cross the language boundary once.
+        bool isBatched = false;
 
         //! If a type proxy function has been created for this function, a representation will be stored here.
         struct TypeProxy
@@ -254,7 +345,8 @@ namespace polyglot
             std::optional<Value> value;
         };
         
-        //! Inferred tag type
+        //! The integer type that the enum is represented as (e.g. Type::Uint8 for `enum class Foo : uint8_t`). The base type
+        //! is Undefined if it isn't known.
         QualifiedType tagType;
 
         virtual ASTNodeType nodeType() const override;
@@ -281,6 +373,10 @@ namespace polyglot
         //! The class name.
         std::string name;
 
+        //! The fully qualified C++ name of the class (e.g. "ns::Foo"). This is used when generating C++ code that has to
+        //! refer to the class from outside of its namespace.
+        std::string qualifiedName;
+
         //! Whether this was declared as a class or a struct.
         Type type;
 
@@ -295,5 +391,39 @@ namespace polyglot
 
         //! The class methods.
         std::vector<FunctionNode> methods;
+
+        //! Compile-time constants defined in the class (i.e. static constexpr members).
+        std::vector<VariableNode> constants;
+
+        //! The size of the class in bytes, as laid out by the source language's compiler. This is 0 if the layout is not
+        //! known (e.g. for a forward declaration).
+        uint64_t size = 0;
+
+        //! The alignment of the class in bytes. This is 0 if the layout is not known.
+        uint64_t alignment = 0;
+
+        //! Whether the alignment of the class was set explicitly (e.g. with `alignas` or `__attribute__((aligned))`), so
+        //! that the bindings have to request it instead of relying on the natural alignment of the members.
+        bool isExplicitlyAligned = false;
+
+        //! The maximum alignment of the members if the class is packed: 1 for `__attribute__((packed))`, N for
+        //! `#pragma pack(N)`. This is 0 if the class is not packed.
+        uint64_t packing = 0;
+
+        //! Whether the class has a vtable pointer (i.e. it has virtual methods or virtual bases). The vtable pointer comes
+        //! first in the object, so the bindings have to add a field for it.
+        bool isPolymorphic = false;
+
+        //! Whether the class is trivially copyable and passed like a C struct, so that values of it can be passed to and
+        //! returned from functions directly (in registers where the ABI allows it).
+        bool isTriviallyCopyable = false;
+
+        //! Whether the class is annotated with `[[clang::annotate("polyglot::thread_safe")]]` or
+        //! `[[clang::annotate("polyglot::thread_compatible")]]`, i.e. its objects aren't tied to the thread that created
+        //! them and their const methods may be called from several threads at once.
+        bool isThreadCompatible = false;
+
+        //! If the class can be iterated over (i.e. it has begin() and end() methods), this holds the element type.
+        std::optional<QualifiedType> iteratorValueType;
     };
 } // namespace polyglot
@@ -34,18 +34,49 @@ use std::ffi::CString;
             Utils::POLYGLOT_VERSION,
             timeStr.substr(0, timeStr.size() - 1), // remove the '\n'
             Utils::getLanguageName(ast));
+
+        for (const auto &itemTypes : Utils::getIteratorItemTypes(ast))
+            writeIterator(itemTypes, out);
+        for (const auto &containerType : Utils::getContainerTypes(ast))
+        {
+            if (containerType.baseType == Type::CppStdVector)
+                writeVectorHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdFuture)
+                writeFutureHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdUniquePtr)
+                writeUniquePtrHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdSharedPtr)
+                writeSharedPtrHandle(containerType, out);
+            else
+                writeMapHandle(containerType, out);
+        }
+        for (const auto &optionalType : Utils::getOptionalTypes(ast))
+            writeOptional(optionalType, out);
+        if (Utils::hasMemoryResourceParameters(ast))
+            writeMemoryResource(out);
     }
     ++s_onlyWriteHeaderOnce;
 
     auto writeFunctionString = [this, &ast, &out](const polyglot::FunctionNode &function, bool isClassMethod, bool isProxied) {
+        // The result of a function with a return slot is constructed by a shim in storage that the caller reserves (e.g.
+        // with MaybeUninit), so it doesn't return anything itself.
+        const auto useReturnSlot = function.hasReturnSlot && !isProxied;
+        // Functions that take ownership of parameters are only reachable through a wrapper that takes those by value, and
+        // functions that take callbacks through one that takes closures.
+        const auto isWrapped = !isProxied && (std::any_of(function.parameters.cbegin(),
+                                                          function.parameters.cend(),
+                                                          Utils::isConsumedParameter) ||
+                                              Utils::hasCallbackParameters(function));
         out << std::format(R"({}#[link_name = "{}"] )",
                            std::string(m_indentationDepth, '\t'),
-                           function.mangledName);
-        if (!isProxied)
+                           useReturnSlot ? Utils::getReturnSlotSymbolName(function) : Utils::getSymbolName(function));
+        if (!isProxied && !isWrapped)
             out << "pub ";
-        out << "fn " << function.functionName << '(';
+        out << "fn " << function.functionName << (isWrapped ? "_polyglot_raw" : "") << '(';
 
         std::string params;
+        if (useReturnSlot)
+            params += "result: *mut " + getTypeString(function.returnType) + ", ";
         // note that Rust doesn't support default arguments
         for (const auto &param : function.parameters)
         {
@@ -60,7 +91,7 @@ use std::ffi::CString;
         }
         out << params.substr(0, params.size() - 2) + ')';
 
-        if (function.returnType.baseType != Type::Void)
+        if ((function.returnType.baseType != Type::Void || function.returnType.isPointer) && !useReturnSlot)
         {
             auto type = function.returnType;
             if (type.baseType == Type::Char && type.isConst && type.isPointer)
@@ -77,10 +108,12 @@ use std::ffi::CString;
         for (const auto &param : function.parameters)
         {
             params += param.name + ": ";
-            if (std::find(function.typeProxy.proxiedParameters.begin(),
-                                                        function.typeProxy.proxiedParameters.end(),
-                                                        param.name) != function.typeProxy.proxiedParameters.end())
+            if (param.type.baseType == Type::CppStdString)
                 params += "String";
+            else if (Utils::isContainerType(param.type.baseType))
+                // Only non-const references may be modified by C++; everything else is lent out read-only.
+                params += std::string(param.type.isReference && !param.type.isConst ? "&mut " : "&") +
+                          Utils::getHandleName(param.type);
             else
                 params += getTypeString(param.type);
             params += ", ";
@@ -91,41 +124,51 @@ use std::ffi::CString;
         if (function.returnType.baseType != Type::Void)
         {
             out << " -> ";
-            if (function.typeProxy.isReturnProxied)
-                // For now we're assuming that the only thing being proxied is string types
+            if (function.returnType.baseType == Type::CppStdString)
                 out << "String";
+            else if (Utils::isContainerType(function.returnType.baseType))
+                out << Utils::getHandleName(function.returnType);
             else
                 out << getTypeString(function.returnType);
         }
 
         out << " {\n" << std::string(++m_indentationDepth, '\t') << "unsafe {\n" << std::string(++m_indentationDepth, '\t');
 
-        if (function.typeProxy.isReturnProxied)
+        // A future handle also keeps the state that lets C++ wake the task that waits for it, and a shared_ptr handle
+        // keeps the pointee, so those are built by a constructor.
+        const auto hasHandleConstructor = function.returnType.baseType == Type::CppStdFuture ||
+                                          function.returnType.baseType == Type::CppStdSharedPtr;
+        if (function.returnType.baseType == Type::CppStdString)
             out << "CString::from_raw(";
+        else if (Utils::isContainerType(function.returnType.baseType))
+            out << Utils::getHandleName(function.returnType) << (hasHandleConstructor ? "::new(" : " { ptr: ");
+        else if (function.returnType.baseType == Type::CppStdUniquePtr)
+            out << Utils::getHandleName(function.returnType) << "::from_raw(";
         out << function.typeProxy.proxy->functionName << '(';
 
         params.clear();
         bool addedNewline = false;
         for (const auto &param : function.parameters)
         {
-            const auto convertToRawStr = std::find(function.typeProxy.proxiedParameters.begin(),
-                                                    function.typeProxy.proxiedParameters.end(),
-                                                    param.name) != function.typeProxy.proxiedParameters.end();
-            if (convertToRawStr)
+            if (param.type.baseType == Type::CppStdString)
             {
-                params += '\n' + std::string(m_indentationDepth + 1, '\t') + "CString::new(";
-                addedNewline = true;
-            }
-            params += param.name;
-            if (convertToRawStr)
+                params += '\n' + std::string(m_indentationDepth + 1, '\t') + "CString::new(" + param.name;
                 params += std::format(R"().expect("Failed to convert parameter {} of {} into CString").into_raw())",
                                       param.name,
                                       function.functionName);
+                addedNewline = true;
+            }
+            else if (Utils::isContainerType(param.type.baseType))
+                params += param.name + (param.type.isReference && !param.type.isConst ? ".as_mut_ptr()" : ".as_ptr()");
+            else if (param.type.baseType == Type::CppStdUniquePtr)
+                params += param.name + ".into_raw()";
+            else
+                params += param.name;
             params += ", ";
         }
         out << params.substr(0, params.size() - 2);
 
-        if (function.typeProxy.isReturnProxied)
+        if (function.returnType.baseType == Type::CppStdString)
         {
             out << ")";
             if (addedNewline)
@@ -136,17 +179,29 @@ use std::ffi::CString;
                 << std::format(R"(.expect("Failed to convert C-style string to String in {}")",
                                function.functionName);
         }
-        out << ")\n";
+        out << ')';
+        if (Utils::isContainerType(function.returnType.baseType))
+            out << (hasHandleConstructor ? ")" : " }");
+        else if (function.returnType.baseType == Type::CppStdUniquePtr)
+            out << ')';
+        out << '\n';
         out << std::string(--m_indentationDepth, '\t') << "}\n" << std::string(--m_indentationDepth, '\t') << "}\n";
     };
 
     auto previousNodeType = ASTNodeType::Undefined;
     for (const auto &node : ast.nodes)
     {
-        if (node->nodeType() == ASTNodeType::Function && previousNodeType != ASTNodeType::Function)
+        if (node->nodeType() == ASTNodeType::Function)
         {
-            out << '\n' << std::string(m_indentationDepth, '\t') << "extern {\n";
-            ++m_indentationDepth;
+            // Consecutive functions share an extern block as long as they use the same ABI.
+            const auto abi = getExternAbi(*dynamic_cast<FunctionNode *>(node));
+            if (previousNodeType == ASTNodeType::Function && abi != m_externAbi)
+                out << std::string(--m_indentationDepth, '\t') << "}\n";
+            if (previousNodeType != ASTNodeType::Function || abi != m_externAbi)
+            {
+                m_externAbi = abi;
+                out << '\n' << std::string(m_indentationDepth++, '\t') << std::format("extern \"{}\" {{\n", m_externAbi);
+            }
         }
         else if (node->nodeType() != ASTNodeType::Function && previousNodeType == ASTNodeType::Function)
         {
@@ -165,6 +220,9 @@ use std::ffi::CString;
             out << std::string(m_indentationDepth, '\t') << "#[allow(non_snake_case)]\n"
                 << std::string(m_indentationDepth, '\t') << "pub mod " << ns->name << " {\n";
             ++m_indentationDepth;
+            // Pull in the parent's items so that types like enums and vector handles resolve inside the module.
+            out << std::string(m_indentationDepth, '\t') << "#[allow(unused_imports)]\n"
+                << std::string(m_indentationDepth, '\t') << "use super::*;\n";
             write(ns->ast, out);
             --m_indentationDepth;
             out << std::string(m_indentationDepth, '\t') << "}\n";
@@ -180,10 +238,20 @@ use std::ffi::CString;
                 writeFunctionString(*function->typeProxy.proxy, false, true);
                 out << std::string(--m_indentationDepth, '\t') << "}\n\n";
                 writeProxyFunction(*function);
-                out << std::string(m_indentationDepth++, '\t') << "\nextern {\n";
+                out << std::string(m_indentationDepth++, '\t') << std::format("\nextern \"{}\" {{\n", m_externAbi);
             }
             else
-                writeFunctionString(*function, false, false);
+            {
+                const auto binding = Utils::getCallbackBinding(*function);
+                writeFunctionString(binding, false, false);
+                if (std::any_of(function->parameters.cbegin(), function->parameters.cend(), Utils::isConsumedParameter))
+                    writeConsumingFunction(*function, out);
+                else if (Utils::hasCallbackParameters(binding))
+                    writeCallbackFunction(binding, out);
+            }
+
+            if (function->isBatched)
+                writeBatchFunction(*function, out);
         }
         else
         {
@@ -193,7 +261,8 @@ use std::ffi::CString;
                 if (e == nullptr)
                     throw std::runtime_error("Node claimed to be EnumNode, but cast failed");
 
-                out << std::string(m_indentationDepth, '\t') << "#[repr(C)]\n"
+                const auto repr = e->tagType.baseType == Type::Undefined ? "C" : getTypeString(e->tagType);
+                out << std::string(m_indentationDepth, '\t') << "#[repr(" << repr << ")]\n"
                     << std::string(m_indentationDepth, '\t') << "pub enum " << e->enumName << " {\n";
                 ++m_indentationDepth;
                 for (const auto &enumerator : e->enumerators)
@@ -206,15 +275,36 @@ use std::ffi::CString;
                 --m_indentationDepth;
                 out << std::string(m_indentationDepth, '\t') << "}\n";
             }
+            else if (node->nodeType() == ASTNodeType::Variable)
+            {
+                auto variable = dynamic_cast<VariableNode *>(node);
+                if (variable == nullptr)
+                    throw std::runtime_error("Node claimed to be VariableNode, but cast failed");
+
+                const auto indent = std::string(m_indentationDepth, '\t');
+                if (variable->isConstexpr)
+                    out << indent << getConstantString(*variable) << '\n';
+                else
+                    // The static refers to the C++ variable itself, so reading it is a plain load rather than a call.
+                    out << indent << "extern \"C\" {\n"
+                        << indent << std::format("\t#[link_name = \"{}\"] pub static {}{}: {};\n",
+                                                 variable->mangledName,
+                                                 variable->type.isConst ? "" : "mut ",
+                                                 variable->name,
+                                                 getTypeString(variable->type))
+                        << indent << "}\n";
+            }
             else if (node->nodeType() == ASTNodeType::Class)
             {
                 auto classNode = dynamic_cast<ClassNode *>(node);
                 if (classNode == nullptr)
                     throw std::runtime_error("Node claimed to be ClassNode, but cast failed");
 
-                out << std::string(m_indentationDepth, '\t') << "#[repr(C)]\n"
+                out << std::string(m_indentationDepth, '\t') << "#[repr(" << getStructRepr(*classNode) << ")]\n"
                     << std::string(m_indentationDepth, '\t') << "pub struct " << classNode->name << " {\n";
                 ++m_indentationDepth;
+                if (classNode->isPolymorphic)
+                    out << std::string(m_indentationDepth, '\t') << "__vptr: *const *const std::ffi::c_void,\n";
                 for (const auto &member : classNode->members)
                 {
                     out << std::string(m_indentationDepth, '\t') << "pub "
@@ -227,27 +317,52 @@ use std::ffi::CString;
                 --m_indentationDepth;
                 out << std::string(m_indentationDepth, '\t') << "}\n";
 
-                // TODO: wrap constructors and destructors here
+                writeLayoutAssertions(*classNode, out);
+
+                // Const methods take &self, so sharing an object between threads only allows calls that C++ guarantees
+                // to be safe for thread-compatible classes; everything else needs a &mut.
+                if (classNode->isThreadCompatible)
+                    out << '\n'
+                        << std::string(m_indentationDepth, '\t') << "unsafe impl Send for " << classNode->name << " {}\n"
+                        << std::string(m_indentationDepth, '\t') << "unsafe impl Sync for " << classNode->name << " {}\n";
+
+                if (classNode->iteratorValueType)
+                    writeClassIterator(*classNode, out);
+
+                writeLifetimeFunctions(*classNode, out);
+
+                if (!classNode->constants.empty())
+                {
+                    out << '\n' << std::string(m_indentationDepth, '\t') << "impl " << classNode->name << " {\n";
+                    for (const auto &constant : classNode->constants)
+                        out << std::string(m_indentationDepth + 1, '\t') << getConstantString(constant) << '\n';
+                    out << std::string(m_indentationDepth, '\t') << "}\n";
+                }
 
                 if (!classNode->methods.empty())
                 {
                     // First we will write an impl block. The impl block will contain function definitions that will be
-                    // responsible for calling the actual functions. This probably doesn't support virtual functions yet.
-                    // Eventually I intend to see how tools like bindgen or cxx.rs handle virtual functions and copy that
-                    // method.
+                    // responsible for calling the actual functions. Virtual methods that may be overridden are called
+                    // through the object's vtable; everything else is called directly.
                     out << '\n' << std::string(m_indentationDepth, '\t') << "impl " << classNode->name << " {\n";
                     ++m_indentationDepth;
                     for (const auto &method : classNode->methods)
                     {
+                        // Methods with a return slot construct their result in storage reserved by the caller.
                         out << std::string(m_indentationDepth, '\t')
-                            << std::format("pub fn {}(&mut self", method.functionName);
+                            << std::format("pub {}fn {}({}self",
+                                           method.hasReturnSlot ? "unsafe " : "",
+                                           method.functionName,
+                                           getSelfReference(*classNode, method));
 
                         std::string params;
+                        if (method.hasReturnSlot)
+                            params += ", result: *mut " + getTypeString(method.returnType);
                         for (const auto &param : method.parameters)
-                            params += ", " + param.name + ": " + getTypeString(param.type);
+                            params += ", " + getWrapperParameterString(param);
                         out << params << ')';
 
-                        if (method.returnType.baseType != Type::Void)
+                        if (method.returnType.baseType != Type::Void && !method.hasReturnSlot)
                             out << " -> " << getTypeString(method.returnType);
                         out << " {\n";
 
@@ -255,12 +370,19 @@ use std::ffi::CString;
                         // to compile it. On the plus side, the unsafe call here lets us use the wrapped function in safe
                         // Rust code; if you trust your external code to be safe, this could be really nice.
                         ++m_indentationDepth;
-                        out << std::string(m_indentationDepth, '\t') << "unsafe { polyglot_" << classNode->name << "_method_"
-                            << method.functionName << "(self";
-                        params.clear();
-                        for (const auto &param : method.parameters)
-                            params += ", " + param.name;
-                        out << params << ") }\n";
+                        if (Utils::needsVirtualDispatch(method))
+                            writeVirtualCall(*classNode, method, out);
+                        else
+                        {
+                            out << std::string(m_indentationDepth, '\t') << "unsafe { polyglot_" << classNode->name
+                                << "_method_" << method.functionName << "(self";
+                            params.clear();
+                            if (method.hasReturnSlot)
+                                params += ", result";
+                            for (const auto &param : method.parameters)
+                                params += ", " + getWrapperArgumentString(param);
+                            out << params << ") }\n";
+                        }
                         --m_indentationDepth;
 
                         out << std::string(m_indentationDepth, '\t') << "}\n";
@@ -272,28 +394,43 @@ use std::ffi::CString;
                     // ever cause conflicts with user defined symbols; I don't see any reasonable case where it would cause a
                     // problem; any naming collisions will probably be a result of abuse rather than accidentally breaking
                     // things.
-                    out << std::string(m_indentationDepth, '\t') << "extern {\n";
-                    ++m_indentationDepth;
-                    for (const auto &method : classNode->methods)
+                    for (const auto abi : {"C", "C-unwind"})
                     {
-                        out << std::format("\t"
-                                           R"(#[link_name = "{}"] fn polyglot_{}_method_{}(this: &mut {})",
-                                           method.mangledName,
-                                           classNode->name,
-                                           method.functionName,
-                                           classNode->name);
+                        if (std::none_of(classNode->methods.cbegin(), classNode->methods.cend(), [abi](const auto &method) {
+                                return getExternAbi(method) == abi && !Utils::needsVirtualDispatch(method);
+                            }))
+                            continue;
 
-                        std::string params;
-                        for (const auto &param : method.parameters)
-                            params += ", " + param.name + ": " + getTypeString(param.type);
-                        out << params << ')';
+                        out << std::string(m_indentationDepth, '\t') << std::format("extern \"{}\" {{\n", abi);
+                        ++m_indentationDepth;
+                        for (const auto &method : classNode->methods)
+                        {
+                            if (getExternAbi(method) != abi || Utils::needsVirtualDispatch(method))
+                                continue;
 
-                        if (method.returnType.baseType != Type::Void)
-                            out << " -> " << getTypeString(method.returnType);
-                        out << ";\n";
+                            out << std::format("\t"
+                                               R"(#[link_name = "{}"] fn polyglot_{}_method_{}(this: {}{})",
+                                               method.hasReturnSlot ? Utils::getReturnSlotSymbolName(method)
+                                                                    : Utils::getSymbolName(method),
+                                               classNode->name,
+                                               method.functionName,
+                                               getSelfReference(*classNode, method),
+                                               classNode->name);
+
+                            std::string params;
+                            if (method.hasReturnSlot)
+                                params += ", result: *mut " + getTypeString(method.returnType);
+                            for (const auto &param : method.parameters)
+                                params += ", " + param.name + ": " + getTypeString(param.type);
+                            out << params << ')';
+
+                            if (method.returnType.baseType != Type::Void && !method.hasReturnSlot)
+                                out << " -> " << getTypeString(method.returnType);
+                            out << ";\n";
+                        }
+                        --m_indentationDepth;
+                        out << "}\n";
                     }
-                    --m_indentationDepth;
-                    out << "}\n";
                 }
             }
         }
@@ -302,7 +439,7 @@ use std::ffi::CString;
     }
 
     if (previousNodeType == ASTNodeType::Function)
-        out << "}\n";
+        out << std::string(--m_indentationDepth, '\t') << "}\n";
 
     out.flush();
 
@@ -321,7 +458,7 @@ std::string RustWrapperWriter::getTypeString(const QualifiedType &type) const
         typeString += "bool";
         break;
     case Type::Void:
-        typeString += "void";
+        typeString += type.isPointer ? "std::ffi::c_void" : "void";
         break;
     case Type::Char:
         typeString += "i8";// "char";
@@ -378,27 +515,80 @@ std::string RustWrapperWriter::getTypeString(const QualifiedType &type) const
         else
             typeString += type.nameString;
         break;
+    case Type::Vector:
+    {
+        // Stable Rust only has vector types for x86-64. They are named after their size and only distinguish between
+        // f32, f64 and integer lanes, but are passed in the same registers as the C++ types.
+        const auto elementType = type.templateArguments.at(0).baseType;
+        const auto bits = type.elementCount * Utils::getBuiltinTypeSize(elementType) * 8;
+        if (bits != 128 && bits != 256 && bits != 512)
+            throw std::runtime_error("Rust only supports 128-, 256- and 512-bit vectors");
+        typeString += std::format("core::arch::x86_64::__m{}{}",
+                                  bits,
+                                  elementType == Type::Float32   ? ""
+                                  : elementType == Type::Float64 ? "d"
+                                                                 : "i");
+        break;
+    }
     case Type::CppStdString:
         typeString += "basic_string";
         break;
+    case Type::CppStdVector:
+    case Type::CppStdMap:
+    case Type::CppStdUnorderedMap:
+    case Type::CppStdFuture:
+    case Type::CppStdUniquePtr:
+    case Type::CppStdSharedPtr:
+    case Type::CppStdOptional:
+        typeString += Utils::getHandleName(type);
+        break;
+    case Type::CppStdMemoryResource:
+        // Memory resources are opaque; see PolyglotMemoryResource::as_ptr().
+        typeString += "std::ffi::c_void";
+        break;
+    case Type::FunctionPointer:
+        // C++ function pointers may be null, which Rust only allows through Option.
+        typeString += "Option<unsafe extern \"C\" fn" + getSignatureString(type.templateArguments) + '>';
+        break;
     case Type::Undefined:
     default:
         throw std::runtime_error("Undefined type in RustWrapperWriter::getTypeString()");
         break;
     }
 
-    if (type.isPointer)
+    // An array of pointers is wrapped around the pointer type, while a pointer to an array is wrapped around the array.
+    auto addExtents = [&type, &typeString]() {
+        for (auto it = type.arrayExtents.crbegin(); it != type.arrayExtents.crend(); ++it)
+            typeString = std::format("[{}; {}]", typeString, *it);
+    };
+    if (!type.isArray)
+        addExtents();
+
+    // Rvalue references are passed as pointers.
+    if (type.isPointer || type.isRvalueReference)
         typeString = (type.isConst ? "*const " : "*mut ") + typeString;
 
+    if (type.isArray)
+        addExtents();
+
     return typeString;
 }
 
+std::string RustWrapperWriter::getConstantString(const VariableNode &constant) const
+{
+    auto value = getValueString(constant.value.value());
+    // Rust's char can't be initialized from an integer.
+    if (constant.type.baseType == Type::Char32)
+        value = std::format("'\\u{{{:x}}}'", std::stoull(value));
+    return std::format("pub const {}: {} = {};", constant.name, getTypeString(constant.type), value);
+}
+
 std::string RustWrapperWriter::getValueString(const Value &value) const
 {
     switch (value.type)
     {
     case Type::Bool:
-        return std::to_string(std::get<bool>(value.value));
+        return std::get<bool>(value.value) ? "true" : "false";
         break;
     case Type::Char:
         return std::to_string(std::get<char>(value.value));
@@ -423,7 +613,7 @@ std::string RustWrapperWriter::getValueString(const Value &value) const
         break;
     case Type::Float32:
     case Type::Float64:
-        return std::to_string(std::get<double>(value.value));
+        return Utils::getFloatLiteral(std::get<double>(value.value));
         break;
     case Type::Enum:
     case Type::Class:
@@ -442,3 +632,892 @@ std::string RustWrapperWriter::getValueString(const Value &value) const
         break;
     }
 }
+
+void RustWrapperWriter::writeVectorHandle(const QualifiedType &vectorType, std::ostream &out) const
+{
+    const auto handle = Utils::getHandleName(vectorType);
+    out << std::format(R"(
+// Owning handle for a std::vector<{1}> that lives in C++. It derefs to a slice without copying the elements and frees
+// the vector through C++ when it is dropped.
+#[allow(non_camel_case_types)]
+pub struct {0} {{
+	ptr: *mut std::ffi::c_void,
+}}
+
+impl {0} {{
+	pub fn from_slice(data: &[{1}]) -> Self {{
+		unsafe {{ {0} {{ ptr: {3}(data.as_ptr(), data.len()) }} }}
+	}}
+
+	pub fn as_ptr(&self) -> *const std::ffi::c_void {{
+		self.ptr
+	}}
+
+	pub fn as_mut_ptr(&mut self) -> *mut std::ffi::c_void {{
+		self.ptr
+	}}
+}}
+
+impl std::ops::Deref for {0} {{
+	type Target = [{1}];
+
+	fn deref(&self) -> &[{1}] {{
+		unsafe {{
+			let size = {5}(self.ptr);
+			if size == 0 {{
+				return &[];
+			}}
+			std::slice::from_raw_parts({4}(self.ptr), size)
+		}}
+	}}
+}}
+
+impl std::ops::DerefMut for {0} {{
+	fn deref_mut(&mut self) -> &mut [{1}] {{
+		unsafe {{
+			let size = {5}(self.ptr);
+			if size == 0 {{
+				return &mut [];
+			}}
+			std::slice::from_raw_parts_mut({4}(self.ptr), size)
+		}}
+	}}
+}}
+
+impl Drop for {0} {{
+	fn drop(&mut self) {{
+		unsafe {{ {2}(self.ptr) }}
+	}}
+}}
+
+extern {{
+	#[link_name = "{4}"] fn {4}(v: *mut std::ffi::c_void) -> *mut {1};
+	#[link_name = "{5}"] fn {5}(v: *const std::ffi::c_void) -> usize;
+	#[link_name = "{2}"] fn {2}(v: *mut std::ffi::c_void);
+	#[link_name = "{3}"] fn {3}(data: *const {1}, size: usize) -> *mut std::ffi::c_void;
+}}
+)",
+                       handle,
+                       getTypeString(vectorType.templateArguments.at(0)),
+                       Utils::getHelperName(vectorType, "delete"),
+                       Utils::getHelperName(vectorType, "from"),
+                       Utils::getHelperName(vectorType, "data"),
+                       Utils::getHelperName(vectorType, "size"));
+}
+
+void RustWrapperWriter::writeFutureHandle(const QualifiedType &futureType, std::ostream &out) const
+{
+    const auto &valueType = futureType.templateArguments.at(0);
+    out << std::format(R"(
+// Owning handle for a std::future<{1}> that lives in C++. Awaiting it doesn't block: C++ wakes the task once the result
+// is ready, so a single thread can wait for any number of futures. The future is freed through C++ when it is dropped.
+// If the operation threw, awaiting the handle unwinds with that exception. The result can only be taken once, so polling
+// the handle again after that panics.
+#[allow(non_camel_case_types)]
+pub struct {0} {{
+	ptr: *mut std::ffi::c_void,
+	waker: Box<std::sync::Mutex<Option<std::task::Waker>>>,
+	watched: bool,
+	done: bool,
+}}
+
+impl {0} {{
+	fn new(ptr: *mut std::ffi::c_void) -> Self {{
+		{0} {{ ptr, waker: Box::new(std::sync::Mutex::new(None)), watched: false, done: false }}
+	}}
+
+	// Once the result has been taken, the std::future has no state left to ask about.
+	pub fn is_ready(&self) -> bool {{
+		!self.done && unsafe {{ {3}(self.ptr) }}
+	}}
+
+	unsafe extern "C" fn wake(context: *mut std::ffi::c_void) {{
+		let waker = &*(context as *const std::sync::Mutex<Option<std::task::Waker>>);
+		if let Some(waker) = waker.lock().unwrap().take() {{
+			waker.wake();
+		}}
+	}}
+}}
+
+impl std::future::Future for {0} {{
+	type Output = {1};
+
+	fn poll(self: std::pin::Pin<&mut Self>, cx: &mut std::task::Context<'_>) -> std::task::Poll<{1}> {{
+		let this = self.get_mut();
+		if this.done {{
+			panic!("{0} polled after it completed");
+		}}
+		if !this.is_ready() {{
+			*this.waker.lock().unwrap() = Some(cx.waker().clone());
+			if !this.watched {{
+				this.watched = true;
+				unsafe {{ {4}(this.ptr, Self::wake, &*this.waker as *const _ as *mut std::ffi::c_void) }}
+			}}
+			// The result may have become ready before the waker was stored.
+			if !this.is_ready() {{
+				return std::task::Poll::Pending;
+			}}
+		}}
+		// The result is gone even if get() unwinds, so this is set first.
+		this.done = true;
+		std::task::Poll::Ready(unsafe {{ {5}(this.ptr) }})
+	}}
+}}
+
+impl Drop for {0} {{
+	fn drop(&mut self) {{
+		unsafe {{ {2}(self.ptr) }}
+	}}
+}}
+
+extern "C" {{
+	#[link_name = "{3}"] fn {3}(f: *const std::ffi::c_void) -> bool;
+	#[link_name = "{2}"] fn {2}(f: *mut std::ffi::c_void);
+}}
+
+// get() rethrows the exception that the asynchronous operation failed with, and notify() allocates.
+extern "C-unwind" {{
+	#[link_name = "{4}"] fn {4}(f: *const std::ffi::c_void, callback: unsafe extern "C" fn(*mut std::ffi::c_void), context: *mut std::ffi::c_void);
+	#[link_name = "{5}"] fn {5}(f: *mut std::ffi::c_void) -> {1};
+}}
+)",
+                       Utils::getHandleName(futureType),
+                       valueType.baseType == Type::Void ? "()" : getTypeString(valueType),
+                       Utils::getHelperName(futureType, "delete"),
+                       Utils::getHelperName(futureType, "ready"),
+                       Utils::getHelperName(futureType, "notify"),
+                       Utils::getHelperName(futureType, "get"));
+}
+
+void RustWrapperWriter::writeUniquePtrHandle(const QualifiedType &uniquePtrType, std::ostream &out) const
+{
+    out << std::format(R"(
+// Owning handle for a std::unique_ptr<{1}>. It is only the pointer, so it is passed to and from C++ as cheaply as a raw
+// one, and it frees the pointee through C++ when it is dropped.
+#[allow(non_camel_case_types)]
+#[repr(transparent)]
+pub struct {0} {{
+	ptr: Option<std::ptr::NonNull<{1}>>,
+}}
+
+impl {0} {{
+	// Takes ownership of `ptr`, which has to be null or allocated by C++ with new.
+	pub unsafe fn from_raw(ptr: *mut {1}) -> Self {{
+		{0} {{ ptr: std::ptr::NonNull::new(ptr) }}
+	}}
+
+	// Gives up ownership of the pointee without freeing it.
+	pub fn into_raw(self) -> *mut {1} {{
+		let ptr = self.as_ptr();
+		std::mem::forget(self);
+		ptr
+	}}
+
+	pub fn null() -> Self {{
+		{0} {{ ptr: None }}
+	}}
+
+	pub fn is_null(&self) -> bool {{
+		self.ptr.is_none()
+	}}
+
+	pub fn as_ptr(&self) -> *mut {1} {{
+		self.ptr.map_or(std::ptr::null_mut(), std::ptr::NonNull::as_ptr)
+	}}
+
+	pub fn get(&self) -> Option<&{1}> {{
+		self.ptr.map(|ptr| unsafe {{ ptr.as_ref() }})
+	}}
+
+	pub fn get_mut(&mut self) -> Option<&mut {1}> {{
+		self.ptr.map(|mut ptr| unsafe {{ ptr.as_mut() }})
+	}}
+}}
+
+impl Drop for {0} {{
+	fn drop(&mut self) {{
+		if let Some(ptr) = self.ptr {{
+			unsafe {{ {2}(ptr.as_ptr()) }}
+		}}
+	}}
+}}
+
+extern {{
+	#[link_name = "{2}"] fn {2}(p: *mut {1});
+}}
+)",
+                       Utils::getHandleName(uniquePtrType),
+                       getTypeString(uniquePtrType.templateArguments.at(0)),
+                       Utils::getHelperName(uniquePtrType, "delete"));
+}
+
+void RustWrapperWriter::writeSharedPtrHandle(const QualifiedType &sharedPtrType, std::ostream &out) const
+{
+    out << std::format(R"(
+// Owning handle for a std::shared_ptr<{1}> that lives in C++. Cloning it shares ownership like copying the shared_ptr
+// does. The handle keeps the pointee, so get() and as_raw() borrow it without touching the reference count; use them to
+// pass it to functions that take a pointer or a reference. The shared_ptr is freed through C++ when it is dropped.
+#[allow(non_camel_case_types)]
+pub struct {0} {{
+	ptr: *mut std::ffi::c_void,
+	raw: *mut {1},
+}}
+
+impl {0} {{
+	unsafe fn new(ptr: *mut std::ffi::c_void) -> Self {{
+		{0} {{ ptr, raw: {2}(ptr) }}
+	}}
+
+	pub fn as_ptr(&self) -> *const std::ffi::c_void {{
+		self.ptr
+	}}
+
+	pub fn as_raw(&self) -> *mut {1} {{
+		self.raw
+	}}
+
+	pub fn get(&self) -> Option<&{1}> {{
+		unsafe {{ self.raw.as_ref() }}
+	}}
+}}
+
+impl Clone for {0} {{
+	fn clone(&self) -> Self {{
+		unsafe {{ {0} {{ ptr: {3}(self.ptr), raw: self.raw }} }}
+	}}
+}}
+
+impl Drop for {0} {{
+	fn drop(&mut self) {{
+		unsafe {{ {4}(self.ptr) }}
+	}}
+}}
+
+extern {{
+	#[link_name = "{2}"] fn {2}(p: *const std::ffi::c_void) -> *mut {1};
+	#[link_name = "{3}"] fn {3}(p: *const std::ffi::c_void) -> *mut std::ffi::c_void;
+	#[link_name = "{4}"] fn {4}(p: *mut std::ffi::c_void);
+}}
+)",
+                       Utils::getHandleName(sharedPtrType),
+                       getTypeString(sharedPtrType.templateArguments.at(0)),
+                       Utils::getHelperName(sharedPtrType, "get"),
+                       Utils::getHelperName(sharedPtrType, "clone"),
+                       Utils::getHelperName(sharedPtrType, "delete"));
+}
+
+void RustWrapperWriter::writeOptional(const QualifiedType &optionalType, std::ostream &out) const
+{
+    out << std::format(R"(
+// A std::optional<{1}>. It has the same layout, so it is passed by value without any conversion.
+#[allow(non_camel_case_types)]
+#[repr(C)]
+pub struct {0} {{
+	value: std::mem::MaybeUninit<{1}>,
+	has_value: bool,
+}}
+
+impl {0} {{
+	pub fn some(value: {1}) -> Self {{
+		{0} {{ value: std::mem::MaybeUninit::new(value), has_value: true }}
+	}}
+
+	pub fn none() -> Self {{
+		{0} {{ value: std::mem::MaybeUninit::uninit(), has_value: false }}
+	}}
+
+	pub fn as_ref(&self) -> Option<&{1}> {{
+		if self.has_value {{ Some(unsafe {{ self.value.assume_init_ref() }}) }} else {{ None }}
+	}}
+}}
+
+impl From<Option<{1}>> for {0} {{
+	fn from(value: Option<{1}>) -> Self {{
+		match value {{
+			Some(value) => {0}::some(value),
+			None => {0}::none(),
+		}}
+	}}
+}}
+
+impl From<{0}> for Option<{1}> {{
+	fn from(optional: {0}) -> Self {{
+		if optional.has_value {{ Some(unsafe {{ optional.value.assume_init() }}) }} else {{ None }}
+	}}
+}}
+)",
+                       Utils::getHandleName(optionalType),
+                       getTypeString(optionalType.templateArguments.at(0)));
+}
+
+void RustWrapperWriter::writeMemoryResource(std::ostream &out) const
+{
+    out << R"(
+// A std::pmr::memory_resource that allocates from a Rust allocator (e.g. an arena), for functions that take a
+// std::pmr::memory_resource *. The resource borrows the allocator; anything that C++ keeps allocated from it has to be
+// freed before the allocator goes away as well.
+pub struct PolyglotMemoryResource<'a> {
+	ptr: *mut std::ffi::c_void,
+	_allocator: std::marker::PhantomData<&'a ()>,
+}
+
+impl<'a> PolyglotMemoryResource<'a> {
+	pub fn new<A: std::alloc::GlobalAlloc>(allocator: &'a A) -> Self {
+		unsafe extern "C" fn allocate<A: std::alloc::GlobalAlloc>(context: *mut std::ffi::c_void, size: usize, alignment: usize) -> *mut std::ffi::c_void {
+			match std::alloc::Layout::from_size_align(size, alignment) {
+				Ok(layout) => (*(context as *const A)).alloc(layout) as *mut std::ffi::c_void,
+				Err(_) => std::ptr::null_mut(),
+			}
+		}
+		unsafe extern "C" fn deallocate<A: std::alloc::GlobalAlloc>(context: *mut std::ffi::c_void, ptr: *mut std::ffi::c_void, size: usize, alignment: usize) {
+			(*(context as *const A)).dealloc(ptr as *mut u8, std::alloc::Layout::from_size_align_unchecked(size, alignment))
+		}
+
+		let context = allocator as *const A as *mut std::ffi::c_void;
+		unsafe { PolyglotMemoryResource { ptr: polyglot_memory_resource_new(allocate::<A>, deallocate::<A>, context), _allocator: std::marker::PhantomData } }
+	}
+
+	pub fn as_ptr(&self) -> *mut std::ffi::c_void {
+		self.ptr
+	}
+}
+
+impl Drop for PolyglotMemoryResource<'_> {
+	fn drop(&mut self) {
+		unsafe { polyglot_memory_resource_delete(self.ptr) }
+	}
+}
+
+extern {
+	#[link_name = "polyglot_memory_resource_new"] fn polyglot_memory_resource_new(allocate: unsafe extern "C" fn(*mut std::ffi::c_void, usize, usize) -> *mut std::ffi::c_void, deallocate: unsafe extern "C" fn(*mut std::ffi::c_void, *mut std::ffi::c_void, usize, usize), context: *mut std::ffi::c_void) -> *mut std::ffi::c_void;
+	#[link_name = "polyglot_memory_resource_delete"] fn polyglot_memory_resource_delete(resource: *mut std::ffi::c_void);
+}
+)";
+}
+
+void RustWrapperWriter::writeMapHandle(const QualifiedType &mapType, std::ostream &out) const
+{
+    out << std::format(R"(
+// Owning handle for a {1}<{2}, {3}> that lives in C++. Its entries can be iterated over in chunks, and the map is freed
+// through C++ when it is dropped.
+#[allow(non_camel_case_types)]
+pub struct {0} {{
+	ptr: *mut std::ffi::c_void,
+}}
+
+impl {0} {{
+	pub fn new() -> Self {{
+		unsafe {{ {0} {{ ptr: {5}() }} }}
+	}}
+
+	pub fn len(&self) -> usize {{
+		unsafe {{ {6}(self.ptr) }}
+	}}
+
+	pub fn insert(&mut self, key: {2}, value: {3}) {{
+		unsafe {{ {7}(self.ptr, key, value) }}
+	}}
+
+	pub fn iter(&self, chunk_size: usize) -> {4}<'_> {{
+		unsafe {{ {4}::new({9}(self.ptr), {10}, {11}, chunk_size) }}
+	}}
+
+	pub fn as_ptr(&self) -> *const std::ffi::c_void {{
+		self.ptr
+	}}
+
+	pub fn as_mut_ptr(&mut self) -> *mut std::ffi::c_void {{
+		self.ptr
+	}}
+}}
+
+impl Drop for {0} {{
+	fn drop(&mut self) {{
+		unsafe {{ {8}(self.ptr) }}
+	}}
+}}
+
+extern {{
+	#[link_name = "{5}"] fn {5}() -> *mut std::ffi::c_void;
+	#[link_name = "{6}"] fn {6}(m: *const std::ffi::c_void) -> usize;
+	#[link_name = "{7}"] fn {7}(m: *mut std::ffi::c_void, key: {2}, value: {3});
+	#[link_name = "{8}"] fn {8}(m: *mut std::ffi::c_void);
+	#[link_name = "{9}"] fn {9}(m: *const std::ffi::c_void) -> *mut std::ffi::c_void;
+	#[link_name = "{10}"] fn {10}(state: *mut std::ffi::c_void, keys: *mut {2}, values: *mut {3}, capacity: usize) -> usize;
+	#[link_name = "{11}"] fn {11}(state: *mut std::ffi::c_void);
+}}
+)",
+                       Utils::getHandleName(mapType),
+                       mapType.baseType == Type::CppStdMap ? "std::map" : "std::unordered_map",
+                       getTypeString(mapType.templateArguments.at(0)),
+                       getTypeString(mapType.templateArguments.at(1)),
+                       Utils::getIteratorName(mapType.templateArguments),
+                       Utils::getHelperName(mapType, "new"),
+                       Utils::getHelperName(mapType, "size"),
+                       Utils::getHelperName(mapType, "insert"),
+                       Utils::getHelperName(mapType, "delete"),
+                       Utils::getHelperName(mapType, "iter_begin"),
+                       Utils::getHelperName(mapType, "iter_next"),
+                       Utils::getHelperName(mapType, "iter_free"));
+}
+
+void RustWrapperWriter::writeIterator(const std::vector<QualifiedType> &itemTypes, std::ostream &out) const
+{
+    const auto name = Utils::getIteratorName(itemTypes);
+
+    std::string itemType;
+    std::string bufferPointerTypes;
+    std::string bufferFields;
+    std::string bufferInits;
+    std::string bufferArgs;
+    std::string bufferLengths;
+    std::string item;
+    for (size_t i = 0; i < itemTypes.size(); ++i)
+    {
+        const auto type = getTypeString(itemTypes[i]);
+        itemType += type + ", ";
+        bufferPointerTypes += "*mut " + type + ", ";
+        bufferFields += std::format("\tbuffer{}: Vec<{}>,\n", i, type);
+        bufferInits += std::format("\t\t\tbuffer{}: Vec::with_capacity(chunk_size),\n", i);
+        bufferArgs += std::format("self.buffer{}.as_mut_ptr(), ", i);
+        bufferLengths += std::format("\t\t\t\tself.buffer{}.set_len(length);\n", i);
+        item += std::format("self.buffer{}[self.position], ", i);
+    }
+    itemType = itemType.substr(0, itemType.size() - 2);
+    item = item.substr(0, item.size() - 2);
+    if (itemTypes.size() > 1)
+    {
+        itemType = '(' + itemType + ')';
+        item = '(' + item + ')';
+    }
+
+    out << std::format(R"(
+// Iterates over a C++ container, copying up to `chunk_size` items out of C++ per boundary crossing.
+#[allow(non_camel_case_types)]
+pub struct {0}<'a> {{
+	state: *mut std::ffi::c_void,
+	next_chunk: unsafe extern "C" fn(*mut std::ffi::c_void, {2}usize) -> usize,
+	free: unsafe extern "C" fn(*mut std::ffi::c_void),
+	chunk_size: usize,
+{3}	position: usize,
+	_container: std::marker::PhantomData<&'a ()>,
+}}
+
+impl<'a> {0}<'a> {{
+	unsafe fn new(
+		state: *mut std::ffi::c_void,
+		next_chunk: unsafe extern "C" fn(*mut std::ffi::c_void, {2}usize) -> usize,
+		free: unsafe extern "C" fn(*mut std::ffi::c_void),
+		chunk_size: usize,
+	) -> Self {{
+		let chunk_size = chunk_size.max(1);
+		{0} {{
+			state,
+			next_chunk,
+			free,
+			chunk_size,
+{4}			position: 0,
+			_container: std::marker::PhantomData,
+		}}
+	}}
+}}
+
+impl<'a> Iterator for {0}<'a> {{
+	type Item = {1};
+
+	fn next(&mut self) -> Option<{1}> {{
+		if self.position == self.buffer0.len() {{
+			if self.state.is_null() {{
+				return None;
+			}}
+			unsafe {{
+				let length = (self.next_chunk)(self.state, {5}self.chunk_size);
+{6}			}}
+			self.position = 0;
+			if self.buffer0.is_empty() {{
+				unsafe {{ (self.free)(self.state) }}
+				self.state = std::ptr::null_mut();
+				return None;
+			}}
+		}}
+		let item = {7};
+		self.position += 1;
+		Some(item)
+	}}
+}}
+
+impl<'a> Drop for {0}<'a> {{
+	fn drop(&mut self) {{
+		if !self.state.is_null() {{
+			unsafe {{ (self.free)(self.state) }}
+		}}
+	}}
+}}
+)",
+                       name,
+                       itemType,
+                       bufferPointerTypes,
+                       bufferFields,
+                       bufferInits,
+                       bufferArgs,
+                       bufferLengths,
+                       item);
+}
+
+void RustWrapperWriter::writeClassIterator(const ClassNode &classNode, std::ostream &out)
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+    const auto iterator = Utils::getIteratorName({*classNode.iteratorValueType});
+    const auto begin = Utils::getClassHelperName(classNode, "iter_begin");
+    const auto next = Utils::getClassHelperName(classNode, "iter_next");
+    const auto free = Utils::getClassHelperName(classNode, "iter_free");
+
+    out << '\n' << indent << "impl " << classNode.name << " {\n"
+        << indent << std::format("\tpub fn iter(&mut self, chunk_size: usize) -> {}<'_> {{\n", iterator)
+        << indent << std::format("\t\tunsafe {{ {}::new({}(self), {}, {}, chunk_size) }}\n", iterator, begin, next, free)
+        << indent << "\t}\n"
+        << indent << "}\n\n"
+        << indent << "extern {\n"
+        << indent << std::format("\t#[link_name = \"{0}\"] fn {0}(this: &mut {1}) -> *mut std::ffi::c_void;\n",
+                                 begin,
+                                 classNode.name)
+        << indent << std::format("\t#[link_name = \"{0}\"] fn {0}(state: *mut std::ffi::c_void, values: *mut {1}, "
+                                 "capacity: usize) -> usize;\n",
+                                 next,
+                                 getTypeString(*classNode.iteratorValueType))
+        << indent << std::format("\t#[link_name = \"{0}\"] fn {0}(state: *mut std::ffi::c_void);\n", free)
+        << indent << "}\n";
+}
+
+void RustWrapperWriter::writeConsumingFunction(const FunctionNode &function, std::ostream &out)
+{
+    std::string params;
+    std::string args;
+    if (function.hasReturnSlot)
+    {
+        params += "result: *mut " + getTypeString(function.returnType) + ", ";
+        args += "result, ";
+    }
+    for (const auto &param : function.parameters)
+    {
+        params += getWrapperParameterString(param) + ", ";
+        args += getWrapperArgumentString(param) + ", ";
+    }
+
+    out << std::string(--m_indentationDepth, '\t') << "}\n\n";
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent << "#[allow(non_snake_case)]\n"
+        << indent << "pub " << (function.hasReturnSlot ? "unsafe " : "") << "fn " << function.functionName << '('
+        << params.substr(0, params.size() - 2) << ')';
+    if (function.returnType.baseType != Type::Void && !function.hasReturnSlot)
+        out << " -> " << getTypeString(function.returnType);
+    out << " {\n"
+        << indent << "\tunsafe { " << function.functionName << "_polyglot_raw(" << args.substr(0, args.size() - 2) << ") }\n"
+        << indent << "}\n";
+
+    out << '\n' << std::string(m_indentationDepth++, '\t') << std::format("extern \"{}\" {{\n", m_externAbi);
+}
+
+std::string RustWrapperWriter::getWrapperParameterString(const VariableNode &param) const
+{
+    if (!Utils::isConsumedParameter(param))
+        return param.name + ": " + getTypeString(param.type);
+
+    auto type = param.type;
+    type.isRvalueReference = false;
+    return "mut " + param.name + ": " + getTypeString(type);
+}
+
+std::string RustWrapperWriter::getWrapperArgumentString(const VariableNode &param)
+{
+    return Utils::isConsumedParameter(param) ? "&mut " + param.name : param.name;
+}
+
+void RustWrapperWriter::writeCallbackFunction(const FunctionNode &function, std::ostream &out)
+{
+    out << std::string(--m_indentationDepth, '\t') << "}\n\n";
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    std::string generics;
+    std::string params;
+    std::string args;
+    std::string trampolines;
+    for (size_t i = 0; i < function.parameters.size(); ++i)
+    {
+        const auto &param = function.parameters[i];
+        if (!Utils::isCallbackParameter(function, i))
+        {
+            params += param.name + ": " + getTypeString(param.type) + ", ";
+            args += param.name + ", ";
+            continue;
+        }
+
+        // The closure is passed by reference as the context pointer, and a trampoline that is monomorphized for its type
+        // casts it back and calls it. Nothing is boxed, so the closure itself must outlive every call made from C++.
+        auto signature = param.type.templateArguments;
+        signature.pop_back();
+        const auto closure = 'F' + std::to_string(i);
+        const auto bound = closure + ": FnMut" + getSignatureString(signature);
+        generics += bound + ", ";
+        params += param.name + ": &mut " + closure + ", ";
+        args += std::format("Some(trampoline{0}::<{1}>), {2} as *mut {1} as *mut std::ffi::c_void, ", i, closure, param.name);
+
+        std::string trampolineParams;
+        std::string trampolineArgs;
+        for (size_t j = 1; j < signature.size(); ++j)
+        {
+            trampolineParams += std::format("a{}: {}, ", j - 1, getTypeString(signature[j]));
+            trampolineArgs += std::format("a{}, ", j - 1);
+        }
+        const auto &returnType = signature.front();
+        trampolines += indent + std::format("\tunsafe extern \"C\" fn trampoline{}<{}>({}context: *mut std::ffi::c_void)",
+                                            i,
+                                            bound,
+                                            trampolineParams);
+        if (returnType.baseType != Type::Void || returnType.isPointer)
+            trampolines += " -> " + getTypeString(returnType);
+        trampolines += " {\n" + indent + "\t\tunsafe { (*(context as *mut " + closure + "))(" +
+                       trampolineArgs.substr(0, trampolineArgs.size() - 2) + ") }\n" + indent + "\t}\n";
+        ++i; // The context pointer is filled in by the wrapper.
+    }
+
+    out << indent << "#[allow(non_snake_case)]\n"
+        << indent << "pub unsafe fn " << function.functionName << '<' << generics.substr(0, generics.size() - 2) << ">("
+        << params.substr(0, params.size() - 2) << ')';
+    if (function.returnType.baseType != Type::Void || function.returnType.isPointer)
+        out << " -> " << getTypeString(function.returnType);
+    out << " {\n"
+        << trampolines
+        << indent << "\tunsafe { " << function.functionName << "_polyglot_raw(" << args.substr(0, args.size() - 2) << ") }\n"
+        << indent << "}\n";
+
+    out << '\n' << std::string(m_indentationDepth++, '\t') << std::format("extern \"{}\" {{\n", m_externAbi);
+}
+
+std::string RustWrapperWriter::getSignatureString(const std::vector<QualifiedType> &signature) const
+{
+    std::string params;
+    for (auto it = signature.cbegin() + 1; it != signature.cend(); ++it)
+        params += getTypeString(*it) + ", ";
+
+    auto ret = '(' + params.substr(0, params.size() - 2) + ')';
+    if (signature.front().baseType != Type::Void || signature.front().isPointer)
+        ret += " -> " + getTypeString(signature.front());
+    return ret;
+}
+
+void RustWrapperWriter::writeBatchFunction(const FunctionNode &function, std::ostream &out)
+{
+    const auto hasResults = function.returnType.baseType != Type::Void;
+    const auto externName = function.functionName + "_polyglot_batch";
+    // All arrays have to be as long as the first one; with results, that's the results array.
+    const auto countSource = hasResults ? std::string{"results"} : function.parameters.at(0).name;
+
+    std::string externParams;
+    std::string params;
+    std::string checks;
+    std::string args;
+    for (const auto &param : function.parameters)
+    {
+        externParams += param.name + ": *const " + getTypeString(param.type) + ", ";
+        params += param.name + ": &[" + getTypeString(param.type) + "], ";
+        if (param.name != countSource)
+            checks += param.name + ".len() == count && ";
+        args += param.name + ".as_ptr(), ";
+    }
+    if (hasResults)
+    {
+        externParams += "results: *mut " + getTypeString(function.returnType) + ", ";
+        params += "results: &mut [" + getTypeString(function.returnType) + "], ";
+        args += "results.as_mut_ptr(), ";
+    }
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent
+        << std::format(R"(#[link_name = "{}"] fn {}({}count: usize);)", Utils::getBatchSymbolName(function), externName, externParams)
+        << '\n';
+    out << std::string(--m_indentationDepth, '\t') << "}\n\n";
+
+    // Calls the function once for each set of arguments, crossing into C++ only once for the whole batch.
+    const auto outer = std::string(m_indentationDepth, '\t');
+    out << outer << "#[allow(non_snake_case)]\n"
+        << outer << "pub fn " << function.functionName << "_batch(" << params.substr(0, params.size() - 2) << ") {\n"
+        << outer << "\tlet count = " << countSource << ".len();\n";
+    if (!checks.empty())
+        out << outer << "\tassert!(" << checks.substr(0, checks.size() - 4)
+            << std::format(R"(, "All batch arrays passed to {}_batch must have the same length");)", function.functionName)
+            << '\n';
+    out << outer << "\tunsafe { " << externName << '(' << args << "count) }\n"
+        << outer << "}\n";
+
+    out << '\n' << std::string(m_indentationDepth++, '\t') << std::format("extern \"{}\" {{\n", m_externAbi);
+}
+
+std::string RustWrapperWriter::getExternAbi(const FunctionNode &function)
+{
+    const auto &boundFunction = function.typeProxy.isValid ? *function.typeProxy.proxy : function;
+    return boundFunction.isNothrow ? "C" : "C-unwind";
+}
+
+std::string RustWrapperWriter::getSelfReference(const ClassNode &classNode, const FunctionNode &method)
+{
+    return method.isConst && classNode.isThreadCompatible ? "&" : "&mut ";
+}
+
+void RustWrapperWriter::writeLifetimeFunctions(const ClassNode &classNode, std::ostream &out)
+{
+    // The layout is needed to reserve storage for the object, so there is nothing to construct without it.
+    if (classNode.size == 0)
+        return;
+
+    std::vector<const FunctionNode *> constructors;
+    for (const auto &constructor : classNode.constructors)
+    {
+        if (!Utils::isCopyConstructor(classNode, constructor))
+            constructors.push_back(&constructor);
+    }
+    if (constructors.empty() && !classNode.destructor)
+        return;
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    // Rust doesn't have overloading, so every constructor after the first one gets a numbered name.
+    auto getSuffix = [](size_t i) {
+        return i == 0 ? std::string{} : std::to_string(i);
+    };
+
+    if (!constructors.empty())
+    {
+        out << '\n' << indent << "impl " << classNode.name << " {\n";
+        for (size_t i = 0; i < constructors.size(); ++i)
+        {
+            std::string params;
+            std::string args;
+            for (const auto &param : constructors[i]->parameters)
+            {
+                params += ", " + getWrapperParameterString(param);
+                args += ", " + getWrapperArgumentString(param);
+            }
+
+            // The object is built directly in the caller's storage (e.g. a MaybeUninit on the stack or a slot in an
+            // arena), so constructing it doesn't allocate.
+            out << indent
+                << std::format("\tpub unsafe fn construct_at{}(this: *mut Self{}) {{\n", getSuffix(i), params)
+                << indent << std::format("\t\tpolyglot_{}_ctor{}(this{});\n", classNode.name, getSuffix(i), args)
+                << indent << "\t}\n";
+
+            // Returning by value moves the object, which is only safe if C++ would allow copying it byte by byte.
+            if (classNode.isTriviallyCopyable)
+                out << indent << std::format("\tpub fn new{}({}) -> Self {{\n", getSuffix(i), params.empty() ? "" : params.substr(2))
+                    << indent << "\t\tlet mut this = std::mem::MaybeUninit::<Self>::uninit();\n"
+                    << indent << "\t\tunsafe {\n"
+                    << indent << std::format("\t\t\tSelf::construct_at{}(this.as_mut_ptr(){});\n", getSuffix(i), args)
+                    << indent << "\t\t\tthis.assume_init()\n"
+                    << indent << "\t\t}\n"
+                    << indent << "\t}\n";
+        }
+        out << indent << "}\n";
+    }
+
+    if (classNode.destructor)
+        out << '\n'
+            << indent << "impl Drop for " << classNode.name << " {\n"
+            << indent << "\tfn drop(&mut self) {\n"
+            << indent << std::format("\t\tunsafe {{ polyglot_{}_dtor(self) }}\n", classNode.name)
+            << indent << "\t}\n"
+            << indent << "}\n";
+
+    // Now the bindings to the complete-object constructors and destructor (or the shims standing in for them).
+    out << '\n';
+    for (size_t i = 0; i < constructors.size(); ++i)
+    {
+        std::string params;
+        for (const auto &param : constructors[i]->parameters)
+            params += ", " + param.name + ": " + getTypeString(param.type);
+        out << indent << std::format("extern \"{}\" {{\n", getExternAbi(*constructors[i]))
+            << indent
+            << std::format("\t#[link_name = \"{}\"] fn polyglot_{}_ctor{}(this: *mut {}{});\n",
+                           Utils::getSymbolName(*constructors[i]),
+                           classNode.name,
+                           getSuffix(i),
+                           classNode.name,
+                           params)
+            << indent << "}\n";
+    }
+    if (classNode.destructor)
+        out << indent << std::format("extern \"{}\" {{\n", getExternAbi(*classNode.destructor))
+            << indent
+            << std::format("\t#[link_name = \"{}\"] fn polyglot_{}_dtor(this: *mut {});\n",
+                           Utils::getSymbolName(*classNode.destructor),
+                           classNode.name,
+                           classNode.name)
+            << indent << "}\n";
+}
+
+void RustWrapperWriter::writeVirtualCall(const ClassNode &classNode, const FunctionNode &method, std::ostream &out) const
+{
+    // C++ methods take `this` as a hidden first parameter, so the vtable entry can be called like a C function.
+    std::string params = getSelfReference(classNode, method) + classNode.name;
+    std::string args = "self";
+    for (const auto &param : method.parameters)
+    {
+        params += ", " + getTypeString(param.type);
+        args += ", " + getWrapperArgumentString(param);
+    }
+    std::string returnType;
+    if (method.returnType.baseType != Type::Void)
+        returnType = " -> " + getTypeString(method.returnType);
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent << "unsafe {\n"
+        << indent
+        << std::format("\tlet f: unsafe extern \"{}\" fn({}){} = std::mem::transmute(*self.__vptr.add({}));\n",
+                       getExternAbi(method),
+                       params,
+                       returnType,
+                       *method.vtableIndex)
+        << indent << std::format("\tf({})\n", args) << indent << "}\n";
+}
+
+std::string RustWrapperWriter::getStructRepr(const ClassNode &classNode)
+{
+    if (classNode.packing > 0 && classNode.isExplicitlyAligned)
+        throw std::runtime_error(
+            std::format("{} is both packed and explicitly aligned, which can't be represented in Rust", classNode.name));
+
+    if (classNode.packing == 1)
+        return "C, packed";
+    if (classNode.packing > 1)
+        return std::format("C, packed({})", classNode.packing);
+    if (classNode.isExplicitlyAligned && classNode.alignment > 0)
+        return std::format("C, align({})", classNode.alignment);
+    return "C";
+}
+
+void RustWrapperWriter::writeLayoutAssertions(const ClassNode &classNode, std::ostream &out) const
+{
+    if (classNode.size == 0 || classNode.members.empty())
+        return;
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << '\n'
+        << indent
+        << std::format("const _: () = assert!(std::mem::size_of::<{0}>() == {1}, \"size of {0} does not match C++\");\n",
+                       classNode.name,
+                       classNode.size)
+        << indent
+        << std::format("const _: () = assert!(std::mem::align_of::<{0}>() == {1}, \"alignment of {0} does not match C++\");\n",
+                       classNode.name,
+                       classNode.alignment);
+    for (const auto &member : classNode.members)
+    {
+        if (!member.offset)
+            continue;
+        out << indent
+            << std::format("const _: () = assert!(std::mem::offset_of!({0}, {1}) == {2}, \"offset of {0}::{1} does not match "
+                           "C++\");\n",
+                           classNode.name,
+                           member.name,
+                           *member.offset);
+    }
+}
@@ -16,5 +16,60 @@ protected:
     std::string getValueString(const polyglot::Value &value) const final;
 
 private:
+    void writeVectorHandle(const polyglot::QualifiedType &vectorType, std::ostream &out) const;
+    void writeMapHandle(const polyglot::QualifiedType &mapType, std::ostream &out) const;
+    void writeFutureHandle(const polyglot::QualifiedType &futureType, std::ostream &out) const;
+    void writeUniquePtrHandle(const polyglot::QualifiedType &uniquePtrType, std::ostream &out) const;
+    void writeSharedPtrHandle(const polyglot::QualifiedType &sharedPtrType, std::ostream &out) const;
+    void writeOptional(const polyglot::QualifiedType &optionalType, std::ostream &out) const;
+    void writeMemoryResource(std::ostream &out) const;
+    void writeIterator(const std::vector<polyglot::QualifiedType> &itemTypes, std::ostream &out) const;
+    void writeClassIterator(const polyglot::ClassNode &classNode, std::ostream &out);
+    //! Writes constructors that build the object in place, a Drop implementation that calls the destructor and the
+    //! bindings behind them.
+    void writeLifetimeFunctions(const polyglot::ClassNode &classNode, std::ostream &out);
+    //! Writes compile-time assertions that the struct generated for `classNode` has the same layout as the C++ class.
+    void writeLayoutAssertions(const polyglot::ClassNode &classNode, std::ostream &out) const;
+    //! Writes the safe wrapper for a function that takes ownership of some of its parameters (see
+    //! Utils::isConsumedParameter()). This has to be called from inside an extern block; the block is closed and reopened
+    //! around the wrapper.
+    void writeConsumingFunction(const polyglot::FunctionNode &function, std::ostream &out);
+    //! Writes the wrapper for a function that takes callbacks (see Utils::hasCallbackParameters()), which takes a closure
+    //! for each callback and context pair of `function` and passes it on through a trampoline. `function` has to be the
+    //! declaration returned by Utils::getCallbackBinding(). This has to be called from inside an extern block; the block
+    //! is closed and reopened around the wrapper.
+    void writeCallbackFunction(const polyglot::FunctionNode &function, std::ostream &out);
+    //! Returns the parameter list and return type of a function pointer type (e.g. "(i32) -> f64"). `signature` holds
+    //! the return type followed by the parameter types.
+    std::string getSignatureString(const std::vector<polyglot::QualifiedType> &signature) const;
+    //! Returns `param` as it is declared by a wrapper. Consumed parameters are taken by value, so the caller gives up
+    //! the object; the wrapper lends it to C++ and drops the moved-from remains afterwards.
+    std::string getWrapperParameterString(const polyglot::VariableNode &param) const;
+    //! Returns the argument that a wrapper passes on to the binding for `param`.
+    static std::string getWrapperArgumentString(const polyglot::VariableNode &param);
+
+    //! Writes the slice-based wrapper for a function annotated with "polyglot::batch". This has to be called from inside
+    //! an extern block; the block is closed and reopened around the wrapper.
+    void writeBatchFunction(const polyglot::FunctionNode &function, std::ostream &out);
+
+    //! Writes the body of a method that calls the implementation found in the object's vtable.
+    void writeVirtualCall(const polyglot::ClassNode &classNode, const polyglot::FunctionNode &method, std::ostream &out) const;
+
+    //! Returns the definition of a compile-time constant.
+    std::string getConstantString(const polyglot::VariableNode &constant) const;
+
+    //! Returns the ABI string for the extern block that declares `function`. Functions that may throw are declared as
+    //! "C-unwind", since unwinding through a "C" declaration is undefined behavior; noexcept functions get the "C" ABI,
+    //! which lets rustc treat calls to them as nounwind.
+    static std::string getExternAbi(const polyglot::FunctionNode &function);
+    //! Returns how `method` borrows the object ("&" or "&mut "). Only const methods of thread-compatible classes take
+    //! &self: a plain struct is Sync in Rust, so for any other class, &self would let several threads call const methods
+    //! that touch mutable state at once.
+    static std::string getSelfReference(const polyglot::ClassNode &classNode, const polyglot::FunctionNode &method);
+    //! Returns the contents of the repr attribute for the struct generated for `classNode` (e.g. "C, align(64)").
+    static std::string getStructRepr(const polyglot::ClassNode &classNode);
+
     int16_t m_indentationDepth = 0;
+    //! The ABI of the extern block that is currently open.
+    std::string m_externAbi;
 };
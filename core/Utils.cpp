@@ -4,6 +4,11 @@
 
 #include "Utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
 std::string Utils::getModuleName(std::string filename)
 {
     // TODO: this should not be the only source of truth for module names; also implement source scanning to check module
@@ -44,3 +49,439 @@ std::string Utils::getLanguageName(const polyglot::AST &ast)
         return "<unrecognized language>";
     }
 }
+
+std::string Utils::getBuiltinTypeName(polyglot::Type type)
+{
+    using polyglot::Type;
+    switch (type)
+    {
+    case Type::Void:
+        return "void";
+    case Type::Bool:
+        return "bool";
+    case Type::Char:
+        return "char";
+    case Type::Char16:
+        return "char16";
+    case Type::Char32:
+        return "char32";
+    case Type::Int8:
+        return "int8";
+    case Type::Int16:
+        return "int16";
+    case Type::Int32:
+        return "int32";
+    case Type::Int64:
+        return "int64";
+    case Type::Int128:
+        return "int128";
+    case Type::Uint8:
+        return "uint8";
+    case Type::Uint16:
+        return "uint16";
+    case Type::Uint32:
+        return "uint32";
+    case Type::Uint64:
+        return "uint64";
+    case Type::Uint128:
+        return "uint128";
+    case Type::Float32:
+        return "float32";
+    case Type::Float64:
+        return "float64";
+    case Type::Float128:
+        return "float128";
+    default:
+        throw std::runtime_error("Type passed to Utils::getBuiltinTypeName() is not a builtin type");
+    }
+}
+
+uint64_t Utils::getBuiltinTypeSize(polyglot::Type type)
+{
+    using polyglot::Type;
+    switch (type)
+    {
+    case Type::Bool:
+    case Type::Char:
+    case Type::Int8:
+    case Type::Uint8:
+        return 1;
+    case Type::Char16:
+    case Type::Int16:
+    case Type::Uint16:
+        return 2;
+    case Type::Char32:
+    case Type::Int32:
+    case Type::Uint32:
+    case Type::Float32:
+        return 4;
+    case Type::Int64:
+    case Type::Uint64:
+    case Type::Float64:
+        return 8;
+    case Type::Int128:
+    case Type::Uint128:
+    case Type::Float128:
+        return 16;
+    default:
+        throw std::runtime_error("Type passed to Utils::getBuiltinTypeSize() is not a builtin type");
+    }
+}
+
+bool Utils::isContainerType(polyglot::Type type)
+{
+    using polyglot::Type;
+    return type == Type::CppStdVector || type == Type::CppStdMap || type == Type::CppStdUnorderedMap ||
+           type == Type::CppStdFuture || type == Type::CppStdSharedPtr;
+}
+
+//! Returns the part of a handle or helper name that stands for the template argument `arg`.
+static std::string getTemplateArgumentName(const polyglot::QualifiedType &arg)
+{
+    if (arg.baseType == polyglot::Type::Class || arg.baseType == polyglot::Type::Enum)
+        return arg.nameString;
+    return Utils::getBuiltinTypeName(arg.baseType);
+}
+
+std::string Utils::getHandleName(const polyglot::QualifiedType &containerType)
+{
+    using polyglot::Type;
+
+    // Containers with a polymorphic allocator are different types in C++, so they get handles of their own.
+    std::string name = containerType.usesPolymorphicAllocator ? "PolyglotPmr" : "Polyglot";
+    switch (containerType.baseType)
+    {
+    case Type::CppStdVector:
+        name += "Vector";
+        break;
+    case Type::CppStdMap:
+        name += "Map";
+        break;
+    case Type::CppStdUnorderedMap:
+        name += "UnorderedMap";
+        break;
+    case Type::CppStdFuture:
+        name += "Future";
+        break;
+    case Type::CppStdUniquePtr:
+        name += "UniquePtr";
+        break;
+    case Type::CppStdSharedPtr:
+        name += "SharedPtr";
+        break;
+    case Type::CppStdOptional:
+        name += "Optional";
+        break;
+    default:
+        throw std::runtime_error("Type passed to Utils::getHandleName() is not a container type");
+    }
+
+    for (const auto &arg : containerType.templateArguments)
+        name += '_' + getTemplateArgumentName(arg);
+    return name;
+}
+
+std::string Utils::getHelperName(const polyglot::QualifiedType &containerType, const std::string &operation)
+{
+    using polyglot::Type;
+
+    std::string name = containerType.usesPolymorphicAllocator ? "polyglot_pmr_" : "polyglot_";
+    switch (containerType.baseType)
+    {
+    case Type::CppStdVector:
+        name += "vector";
+        break;
+    case Type::CppStdMap:
+        name += "map";
+        break;
+    case Type::CppStdUnorderedMap:
+        name += "unordered_map";
+        break;
+    case Type::CppStdFuture:
+        name += "future";
+        break;
+    case Type::CppStdUniquePtr:
+        name += "unique_ptr";
+        break;
+    case Type::CppStdSharedPtr:
+        name += "shared_ptr";
+        break;
+    default:
+        throw std::runtime_error("Type passed to Utils::getHelperName() is not a container type");
+    }
+
+    for (const auto &arg : containerType.templateArguments)
+        name += '_' + getTemplateArgumentName(arg);
+    return name + '_' + operation;
+}
+
+std::vector<polyglot::QualifiedType> Utils::getContainerTypes(const polyglot::AST &ast)
+{
+    using namespace polyglot;
+
+    std::vector<QualifiedType> ret;
+    auto addType = [&ret](const QualifiedType &type) {
+        if (!isContainerType(type.baseType) && type.baseType != Type::CppStdUniquePtr)
+            return;
+        QualifiedType unqualified{type.baseType};
+        unqualified.templateArguments = type.templateArguments;
+        unqualified.usesPolymorphicAllocator = type.usesPolymorphicAllocator;
+        if (std::find(ret.begin(), ret.end(), unqualified) == ret.end())
+            ret.push_back(unqualified);
+    };
+
+    for (const auto &node : ast.nodes)
+    {
+        if (const auto function = dynamic_cast<const FunctionNode *>(node); function)
+        {
+            addType(function->returnType);
+            for (const auto &param : function->parameters)
+                addType(param.type);
+        }
+        else if (const auto ns = dynamic_cast<const NamespaceNode *>(node); ns)
+        {
+            for (const auto &type : getContainerTypes(ns->ast))
+                addType(type);
+        }
+    }
+
+    return ret;
+}
+
+std::vector<polyglot::QualifiedType> Utils::getOptionalTypes(const polyglot::AST &ast)
+{
+    using namespace polyglot;
+
+    std::vector<QualifiedType> ret;
+    auto addType = [&ret](const QualifiedType &type) {
+        if (type.baseType != Type::CppStdOptional)
+            return;
+        QualifiedType unqualified{type.baseType};
+        unqualified.templateArguments = type.templateArguments;
+        if (std::find(ret.begin(), ret.end(), unqualified) == ret.end())
+            ret.push_back(unqualified);
+    };
+    auto addFunctionTypes = [&addType](const FunctionNode &function) {
+        addType(function.returnType);
+        for (const auto &param : function.parameters)
+            addType(param.type);
+    };
+
+    for (const auto &node : ast.nodes)
+    {
+        if (const auto function = dynamic_cast<const FunctionNode *>(node); function)
+            addFunctionTypes(*function);
+        else if (const auto variable = dynamic_cast<const VariableNode *>(node); variable)
+            addType(variable->type);
+        else if (const auto classNode = dynamic_cast<const ClassNode *>(node); classNode)
+        {
+            for (const auto &member : classNode->members)
+                addType(member.type);
+            for (const auto &method : classNode->methods)
+                addFunctionTypes(method);
+            for (const auto &constructor : classNode->constructors)
+                addFunctionTypes(constructor);
+        }
+        else if (const auto ns = dynamic_cast<const NamespaceNode *>(node); ns)
+        {
+            for (const auto &type : getOptionalTypes(ns->ast))
+                addType(type);
+        }
+    }
+
+    return ret;
+}
+
+bool Utils::hasMemoryResourceParameters(const polyglot::AST &ast)
+{
+    using namespace polyglot;
+
+    auto takesMemoryResource = [](const FunctionNode &function) {
+        return std::any_of(function.parameters.cbegin(), function.parameters.cend(), [](const VariableNode &param) {
+            return param.type.baseType == Type::CppStdMemoryResource;
+        });
+    };
+
+    for (const auto &node : ast.nodes)
+    {
+        if (const auto function = dynamic_cast<const FunctionNode *>(node); function && takesMemoryResource(*function))
+            return true;
+        else if (const auto classNode = dynamic_cast<const ClassNode *>(node); classNode)
+        {
+            if (std::any_of(classNode->methods.cbegin(), classNode->methods.cend(), takesMemoryResource) ||
+                std::any_of(classNode->constructors.cbegin(), classNode->constructors.cend(), takesMemoryResource))
+                return true;
+        }
+        else if (const auto ns = dynamic_cast<const NamespaceNode *>(node); ns && hasMemoryResourceParameters(ns->ast))
+            return true;
+    }
+    return false;
+}
+
+std::string Utils::getIteratorName(const std::vector<polyglot::QualifiedType> &itemTypes)
+{
+    std::string name = "PolyglotIter";
+    for (const auto &type : itemTypes)
+        name += '_' + getBuiltinTypeName(type.baseType);
+    return name;
+}
+
+std::vector<std::vector<polyglot::QualifiedType>> Utils::getIteratorItemTypes(const polyglot::AST &ast)
+{
+    using namespace polyglot;
+
+    std::vector<std::vector<QualifiedType>> ret;
+    auto addItemTypes = [&ret](const std::vector<QualifiedType> &itemTypes) {
+        if (std::find(ret.begin(), ret.end(), itemTypes) == ret.end())
+            ret.push_back(itemTypes);
+    };
+
+    // Vectors are exposed as slices, so only maps need a chunked iterator.
+    for (const auto &type : getContainerTypes(ast))
+        if (type.baseType == Type::CppStdMap || type.baseType == Type::CppStdUnorderedMap)
+            addItemTypes(type.templateArguments);
+
+    for (const auto &node : ast.nodes)
+    {
+        if (const auto classNode = dynamic_cast<const ClassNode *>(node); classNode && classNode->iteratorValueType)
+            addItemTypes({*classNode->iteratorValueType});
+        else if (const auto ns = dynamic_cast<const NamespaceNode *>(node); ns)
+        {
+            for (const auto &itemTypes : getIteratorItemTypes(ns->ast))
+                addItemTypes(itemTypes);
+        }
+    }
+
+    return ret;
+}
+
+std::string Utils::getClassHelperName(const polyglot::ClassNode &classNode, const std::string &operation)
+{
+    std::string name = "polyglot_";
+    for (const auto c : classNode.qualifiedName)
+        name += c == ':' ? '_' : c;
+    return name + '_' + operation;
+}
+
+std::string Utils::getFloatLiteral(double value)
+{
+    if (!std::isfinite(value))
+        throw std::runtime_error("Infinite and NaN values can't be written as literals");
+
+    // The shortest representation that parses back to the same value, so that constants don't lose precision.
+    auto literal = std::format("{}", value);
+    if (literal.find_first_of(".e") == std::string::npos)
+        literal += ".0";
+    return literal;
+}
+
+std::string Utils::getSymbolName(const polyglot::FunctionNode &function)
+{
+    return function.isInline ? function.mangledName + "_polyglot_shim" : function.mangledName;
+}
+
+bool Utils::isCopyConstructor(const polyglot::ClassNode &classNode, const polyglot::FunctionNode &constructor)
+{
+    if (constructor.parameters.size() != 1)
+        return false;
+    const auto &type = constructor.parameters.front().type;
+    return type.isReference && type.baseType == polyglot::Type::Class && type.nameString == classNode.name;
+}
+
+bool Utils::isMoveConstructor(const polyglot::ClassNode &classNode, const polyglot::FunctionNode &constructor)
+{
+    if (constructor.parameters.size() != 1)
+        return false;
+    const auto &type = constructor.parameters.front().type;
+    return type.isRvalueReference && type.baseType == polyglot::Type::Class && type.nameString == classNode.name;
+}
+
+bool Utils::isConsumedParameter(const polyglot::VariableNode &param)
+{
+    return param.type.isRvalueReference && !param.type.isConst && param.type.baseType == polyglot::Type::Class;
+}
+
+bool Utils::needsVirtualDispatch(const polyglot::FunctionNode &function)
+{
+    return function.isVirtual && !function.isFinal && !function.hasReturnSlot && function.vtableIndex.has_value();
+}
+
+std::string Utils::getReturnSlotSymbolName(const polyglot::FunctionNode &function)
+{
+    return function.mangledName + "_polyglot_retslot";
+}
+
+std::string Utils::getBatchSymbolName(const polyglot::FunctionNode &function)
+{
+    return function.mangledName + "_polyglot_batch";
+}
+
+bool Utils::isCallbackParameter(const polyglot::FunctionNode &function, size_t index)
+{
+    using namespace polyglot;
+
+    const auto &params = function.parameters;
+    if (index + 1 >= params.size() || params[index].type.baseType != Type::FunctionPointer)
+        return false;
+
+    auto isContextPointer = [](const QualifiedType &type) {
+        return type.baseType == Type::Void && type.isPointer && !type.isConst;
+    };
+    const auto &signature = params[index].type.templateArguments;
+    return signature.size() > 1 && isContextPointer(signature.back()) && isContextPointer(params[index + 1].type);
+}
+
+bool Utils::hasCallbackParameters(const polyglot::FunctionNode &function)
+{
+    for (size_t i = 0; i < function.parameters.size(); ++i)
+    {
+        if (function.parameters[i].type.baseType == polyglot::Type::CppStdFunction || isCallbackParameter(function, i))
+            return true;
+    }
+    return false;
+}
+
+polyglot::FunctionNode Utils::getCallbackBinding(const polyglot::FunctionNode &function)
+{
+    using namespace polyglot;
+
+    if (std::none_of(function.parameters.cbegin(), function.parameters.cend(), [](const auto &param) {
+            return param.type.baseType == Type::CppStdFunction;
+        }))
+        return function;
+
+    auto binding = function;
+    binding.mangledName = getCallbackSymbolName(function);
+    // The shim is always emitted out of line.
+    binding.isInline = false;
+    binding.parameters.clear();
+
+    QualifiedType contextType{Type::Void};
+    contextType.isPointer = true;
+    for (const auto &param : function.parameters)
+    {
+        if (param.type.baseType != Type::CppStdFunction)
+        {
+            binding.parameters.push_back(param);
+            continue;
+        }
+
+        VariableNode callback;
+        callback.name = param.name;
+        callback.type.baseType = Type::FunctionPointer;
+        callback.type.templateArguments = param.type.templateArguments;
+        callback.type.templateArguments.push_back(contextType);
+        binding.parameters.push_back(callback);
+
+        VariableNode context;
+        context.name = param.name + "_context";
+        context.type = contextType;
+        binding.parameters.push_back(context);
+    }
+    return binding;
+}
+
+std::string Utils::getCallbackSymbolName(const polyglot::FunctionNode &function)
+{
+    return function.mangledName + "_polyglot_callback";
+}
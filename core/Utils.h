@@ -14,4 +14,72 @@ namespace Utils
 
     std::string getModuleName(std::string filename);
     std::string getLanguageName(const polyglot::AST &ast);
+
+    //! Returns a short, language-neutral name for a builtin type (e.g. "int32" for Type::Int32). This is used to name
+    //! helper symbols that have to match between the type proxies and the wrappers.
+    std::string getBuiltinTypeName(polyglot::Type type);
+    //! Returns the size of a builtin type in bytes.
+    uint64_t getBuiltinTypeSize(polyglot::Type type);
+
+    //! Whether the type is a standard library container that is bound through an owning handle (e.g. std::vector). This
+    //! includes std::future and std::shared_ptr, whose handles own a future or a shared_ptr rather than a collection.
+    bool isContainerType(polyglot::Type type);
+    //! Returns the name of the owning handle type that wraps a container type or std::unique_ptr (e.g.
+    //! "PolyglotVector_int32"), or of the struct that a std::optional is bound as.
+    std::string getHandleName(const polyglot::QualifiedType &containerType);
+    //! Returns the name of the C helper function that implements `operation` (e.g. "data") for a container handle.
+    std::string getHelperName(const polyglot::QualifiedType &containerType, const std::string &operation);
+    //! Returns the container and std::unique_ptr types used by functions in the AST (including nested namespaces),
+    //! without qualifiers.
+    std::vector<polyglot::QualifiedType> getContainerTypes(const polyglot::AST &ast);
+    //! Returns the std::optional types used anywhere in the AST (including classes and nested namespaces), without
+    //! qualifiers.
+    std::vector<polyglot::QualifiedType> getOptionalTypes(const polyglot::AST &ast);
+    //! Whether any function in the AST (including methods and nested namespaces) takes a std::pmr::memory_resource, in
+    //! which case the bindings need the adapter that wraps their allocators in one.
+    bool hasMemoryResourceParameters(const polyglot::AST &ast);
+
+    //! Returns the name of the chunked iterator type whose items are made up of `itemTypes` (e.g. a key and a value).
+    std::string getIteratorName(const std::vector<polyglot::QualifiedType> &itemTypes);
+    //! Returns the item types of every chunked iterator that the AST needs, i.e. one per map type and iterable class.
+    std::vector<std::vector<polyglot::QualifiedType>> getIteratorItemTypes(const polyglot::AST &ast);
+    //! Returns the name of the C helper function that implements `operation` (e.g. "iter_next") for a class.
+    std::string getClassHelperName(const polyglot::ClassNode &classNode, const std::string &operation);
+
+    //! Returns a floating point literal that is exactly `value` and that all of the target languages accept (e.g. "3.0"
+    //! rather than "3").
+    std::string getFloatLiteral(double value);
+
+    //! Returns the symbol that bindings have to link against to call `function`. This is the mangled name, unless the
+    //! function is inline, in which case it is the name of the out-of-line shim generated for it.
+    std::string getSymbolName(const polyglot::FunctionNode &function);
+    //! Whether `constructor` is the copy constructor of `classNode`. Copy constructors aren't bound, since the bindings
+    //! don't have a notion of copying C++ objects.
+    bool isCopyConstructor(const polyglot::ClassNode &classNode, const polyglot::FunctionNode &constructor);
+    //! Whether `constructor` is the move constructor of `classNode`.
+    bool isMoveConstructor(const polyglot::ClassNode &classNode, const polyglot::FunctionNode &constructor);
+    //! Whether `param` takes ownership of an object, i.e. it is an rvalue reference to a class. The object is left in its
+    //! moved-from state, which still has to be destroyed by its owner.
+    bool isConsumedParameter(const polyglot::VariableNode &param);
+    //! Whether calls to `function` have to be dispatched through the vtable, i.e. it is virtual and may be overridden.
+    //! Final methods and methods of final classes are called directly. Methods with a return slot are always called
+    //! through their shim, which dispatches on the C++ side.
+    bool needsVirtualDispatch(const polyglot::FunctionNode &function);
+    //! Returns the symbol of the shim that constructs the result of a function with a return slot in caller storage.
+    std::string getReturnSlotSymbolName(const polyglot::FunctionNode &function);
+    //! Returns the symbol of the batched entry point for a function annotated with "polyglot::batch".
+    std::string getBatchSymbolName(const polyglot::FunctionNode &function);
+
+    //! Whether the parameter at `index` is a function pointer that is followed by the context pointer it gets called
+    //! with, as in `void (*callback)(int, void *), void *userData`. The bindings let such a pair take a closure.
+    bool isCallbackParameter(const polyglot::FunctionNode &function, size_t index);
+    //! Whether `function` takes a std::function or a callback and context pair (see isCallbackParameter()).
+    bool hasCallbackParameters(const polyglot::FunctionNode &function);
+    //! Returns the C-compatible declaration that the bindings link against for a function with callback parameters.
+    //! Every std::function parameter is replaced by a function pointer that takes a trailing context pointer, followed
+    //! by that context pointer (named after the parameter with a "_context" suffix), and the symbol is that of the shim
+    //! that turns the pair back into a std::function. Other functions are returned unchanged.
+    polyglot::FunctionNode getCallbackBinding(const polyglot::FunctionNode &function);
+    //! Returns the symbol of the shim behind getCallbackBinding().
+    std::string getCallbackSymbolName(const polyglot::FunctionNode &function);
 } // namespace Utils
@@ -28,10 +28,29 @@ R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritte
             Utils::POLYGLOT_VERSION,
             timeStr.substr(0, timeStr.size() - 1), // remove the '\n'
             Utils::getLanguageName(ast)) << "\n";
+
+        for (const auto &itemTypes : Utils::getIteratorItemTypes(ast))
+            writeIterator(itemTypes, out);
+        for (const auto &containerType : Utils::getContainerTypes(ast))
+        {
+            if (containerType.baseType == Type::CppStdVector)
+                writeVectorHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdFuture)
+                writeFutureHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdUniquePtr)
+                writeUniquePtrHandle(containerType, out);
+            else if (containerType.baseType == Type::CppStdSharedPtr)
+                writeSharedPtrHandle(containerType, out);
+            else
+                writeMapHandle(containerType, out);
+        }
+        for (const auto &optionalType : Utils::getOptionalTypes(ast))
+            writeOptional(optionalType, out);
+        if (Utils::hasMemoryResourceParameters(ast))
+            writeMemoryResource(out);
     }
     ++s_onlyWriteHeaderOnce;
 
-    auto previousNodeType = ASTNodeType::Undefined;
     for (const auto &node : ast.nodes)
     {
         if (node->nodeType() == ASTNodeType::Namespace)
@@ -45,22 +64,42 @@ R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritte
             auto function = dynamic_cast<FunctionNode *>(node);
             if (function == nullptr)
                 throw std::runtime_error("Node claimed to be FunctionNode, but cast failed");
-            // extern "c++" need llvm-libc++.
-            out << std::format(R"({}extern "c++" fn @"{}" )",
-                               std::string(m_indentationDepth, '\t'),
-                               function->mangledName)
-               /*<< function->functionName*/ << '(';
-
-            std::string params;
-            // note that Zig doesn't support default arguments
-            for (const auto &param : function->parameters)
-                params += param.name + ": " + getTypeString(param.type) + ", ";
-            out << params.substr(0, params.size() - 2) + ')';
-
-            out << " " << getTypeString(function->returnType);
-            out << ";\n";
-            // function alias
-            out << std::format("pub const {} = {};\n\n", function->functionName, function->mangledName);
+
+            if (function->typeProxy.isValid)
+                writeProxyFunction(*function, out);
+            else
+            {
+                // Functions that take std::function are bound through a shim that takes C callbacks instead.
+                const auto binding = Utils::getCallbackBinding(*function);
+                // The result of a function with a return slot is constructed by a shim in storage that the caller
+                // reserves, so it doesn't return anything itself.
+                const auto symbol = function->hasReturnSlot ? Utils::getReturnSlotSymbolName(*function)
+                                                            : Utils::getSymbolName(binding);
+                // extern "c++" need llvm-libc++.
+                out << std::format(R"({}extern "c++" fn @"{}" )",
+                                   std::string(m_indentationDepth, '\t'),
+                                   symbol)
+                   /*<< function->functionName*/ << '(';
+
+                std::string params;
+                if (function->hasReturnSlot)
+                    params += "result: *" + getTypeString(function->returnType) + ", ";
+                // note that Zig doesn't support default arguments
+                for (const auto &param : binding.parameters)
+                    params += param.name + ": " + getTypeString(param.type) + ", ";
+                out << params.substr(0, params.size() - 2) + ')';
+
+                out << " " << (function->hasReturnSlot ? "void" : getTypeString(function->returnType));
+                out << ";\n";
+                if (Utils::hasCallbackParameters(binding))
+                    writeCallbackFunction(binding, out);
+                else
+                    // function alias
+                    out << std::format("pub const {} = {};\n\n", function->functionName, symbol);
+            }
+
+            if (function->isBatched)
+                writeBatchFunction(*function, out);
         }
         else
         {
@@ -71,8 +110,7 @@ R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritte
                     throw std::runtime_error("Node claimed to be EnumNode, but cast failed");
                 
                 std::string tag{""};
-                // TODO: missing tagType
-                if(e->tagType.nameString.empty()){
+                if (e->tagType.baseType == Type::Undefined) {
                     tag = "enum(c_int)"; // for example
                 } else {
                     tag = std::format("enum({})", getTypeString(e->tagType));
@@ -90,6 +128,25 @@ R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritte
                 --m_indentationDepth;
                 out << std::string(m_indentationDepth, '\t') << "};\n";
             }
+            else if (node->nodeType() == ASTNodeType::Variable)
+            {
+                auto variable = dynamic_cast<VariableNode *>(node);
+                if (variable == nullptr)
+                    throw std::runtime_error("Node claimed to be VariableNode, but cast failed");
+
+                // An extern var can't be renamed, so the variable is bound as a pointer to the symbol instead. Reading
+                // through it is a plain load rather than a call.
+                if (variable->isConstexpr)
+                    out << std::string(m_indentationDepth, '\t') << getConstantString(*variable) << "\n\n";
+                else
+                    out << std::string(m_indentationDepth, '\t')
+                    << std::format(R"(pub const {} = @extern(*{}{}, .{{ .name = "{}" }});)",
+                                   variable->name,
+                                   variable->type.isConst ? "const " : "",
+                                   getTypeString(variable->type),
+                                   variable->mangledName)
+                    << "\n\n";
+            }
             else if (node->nodeType() == ASTNodeType::Class)
             {
                 auto classNode = dynamic_cast<ClassNode *>(node);
@@ -98,49 +155,81 @@ R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritte
 
                 out << std::string(m_indentationDepth, '\t') << "pub const " << classNode->name << " = extern struct " << " {\n";
                 ++m_indentationDepth;
-                for (const auto &member : classNode->members)
+                if (classNode->isPolymorphic)
+                    out << std::string(m_indentationDepth, '\t') << "__vptr: [*]const *const anyopaque,\n";
+                for (size_t i = 0; i < classNode->members.size(); ++i)
                 {
+                    const auto &member = classNode->members[i];
                     out << std::string(m_indentationDepth, '\t')
                         << member.name + ": " + getTypeString(member.type);
+                    // Zig has no alignment attribute for structs, so alignas is reproduced by raising the alignment of the
+                    // first field and packing by lowering the alignment of every field that is over-aligned for it.
+                    if (i == 0 && classNode->isExplicitlyAligned && classNode->alignment > 0)
+                        out << std::format(" align({})", classNode->alignment);
+                    else if (classNode->packing > 0 && member.alignment > classNode->packing)
+                        out << std::format(" align({})", classNode->packing);
                     if (member.value.has_value())
                         out << " = " << getValueString(member.value.value());
                     out << ",\n";
                 }
-                if(classNode->methods.empty())
-                out << "};\n";
-
-                // TODO: wrap constructors and destructors here
+                for (const auto &constant : classNode->constants)
+                    out << std::string(m_indentationDepth, '\t') << getConstantString(constant) << '\n';
+                writeLifetimeFunctions(*classNode, out);
+                if (classNode->iteratorValueType)
+                    writeClassIterator(*classNode, out);
+                if (classNode->methods.empty())
+                {
+                    --m_indentationDepth;
+                    out << "};\n";
+                }
 
                 if (!classNode->methods.empty())
                 {
                     // First we will write an impl block. The impl block will contain function definitions that will be
-                    // responsible for calling the actual functions. This probably doesn't support virtual functions yet.
-                    // Eventually I intend to see how tools like bindgen or cxx.rs handle virtual functions and copy that
-                    // method.
+                    // responsible for calling the actual functions. Virtual methods that may be overridden are called
+                    // through the object's vtable; everything else is called directly.
                     for (const auto &method : classNode->methods)
                     {
                         out << std::string(m_indentationDepth, '\t')
-                            << std::format("pub fn {} (self: {}", method.functionName, classNode->name);
+                            << std::format("pub fn {} (self: *{}", method.functionName, classNode->name);
 
+                        // Methods with a return slot construct their result in storage reserved by the caller.
                         std::string params;
+                        if (method.hasReturnSlot)
+                            params += ", result: *" + getTypeString(method.returnType);
                         for (const auto &param : method.parameters)
                             params += ", " + param.name + ": " + getTypeString(param.type);
-                        out << params << ')';
+                        out << params << ") ";
 
-                        out << getTypeString(method.returnType);
+                        out << (method.hasReturnSlot ? "void" : getTypeString(method.returnType));
                         out << " {\n";
 
-                        // Write the call to the actual member function. Note that we have to wrap it as unsafe to allow Zig
-                        // to compile it. On the plus side, the unsafe call here lets us use the wrapped function in safe
-                        // Zig code; if you trust your external code to be safe, this could be really nice.
                         ++m_indentationDepth;
-                        out << std::string(m_indentationDepth, '\t') << "polyglot_" << classNode->name << "_method_"
-                            << method.functionName << "(self";
-                        params.clear();
+                        std::string args;
+                        if (method.hasReturnSlot)
+                            args += ", result";
                         for (const auto &param : method.parameters)
-                            params += ", " + param.name;
-                        out << params << ");\n\t}\n";
+                            args += ", " + param.name;
+                        if (Utils::needsVirtualDispatch(method))
+                        {
+                            // C++ methods take `this` as a hidden first parameter, so the vtable entry can be called like a
+                            // C function.
+                            std::string paramTypes;
+                            for (const auto &param : method.parameters)
+                                paramTypes += ", " + getTypeString(param.type);
+                            out << std::string(m_indentationDepth, '\t')
+                                << std::format("const f: *const fn (*{}{}) callconv(.C) {} = @ptrCast(self.__vptr[{}]);\n",
+                                               classNode->name,
+                                               paramTypes,
+                                               getTypeString(method.returnType),
+                                               *method.vtableIndex)
+                                << std::string(m_indentationDepth, '\t') << "return f(self" << args << ");\n";
+                        }
+                        else
+                            out << std::string(m_indentationDepth, '\t') << "return polyglot_" << classNode->name
+                                << "_method_" << method.functionName << "(self" << args << ");\n";
                         --m_indentationDepth;
+                        out << std::string(m_indentationDepth, '\t') << "}\n";
 
                         out << std::string(m_indentationDepth, '\t') << "\n";
                     }
@@ -153,49 +242,156 @@ R"(// *** WARNING: autogenerated file, do not modify. Changes will be overwritte
                     // things.
                     for (const auto &method : classNode->methods)
                     {
+                        if (Utils::needsVirtualDispatch(method))
+                            continue;
+
+                        const auto symbol = method.hasReturnSlot ? Utils::getReturnSlotSymbolName(method)
+                                                                 : Utils::getSymbolName(method);
                         out << std::format(
-                                           R"(extern "c++" fn @"{}" (this: {})",
-                                           method.mangledName,
+                                           R"(extern "c++" fn @"{}" (this: *{})",
+                                           symbol,
                                            classNode->name);
 
                         std::string params;
+                        if (method.hasReturnSlot)
+                            params += ", result: *" + getTypeString(method.returnType);
                         for (const auto &param : method.parameters)
                             params += ", " + param.name + ": " + getTypeString(param.type);
-                        out << params << ") " << getTypeString(method.returnType);
-
-                        if (method.returnType.baseType != Type::Void)
-                            out << getTypeString(method.returnType);
+                        out << params << ") " << (method.hasReturnSlot ? "void" : getTypeString(method.returnType));
                         out << ";\n";
                         // function alias
                         out << std::format("pub const polyglot_{}_method_{} = {};\n\n",
                                            classNode->name,
                                            method.functionName,
-                                           method.mangledName);
+                                           symbol);
                     }
                 }
+                writeLifetimeExterns(*classNode, out);
+                if (classNode->iteratorValueType)
+                    writeClassIteratorHelpers(*classNode, out);
+                writeLayoutAssertions(*classNode, out);
             }
         }
-
-        previousNodeType = node->nodeType();
     }
 
-    if (previousNodeType == ASTNodeType::Function)
-        out << "}\n";
-
     out.flush();
 
     --s_onlyWriteHeaderOnce;
 }
 
+void ZigWrapperWriter::writeProxyFunction(const polyglot::FunctionNode &function, std::ostream &out)
+{
+    const auto &proxy = *function.typeProxy.proxy;
+
+    // C strings are passed through as sentinel-terminated pointers, which have the same ABI as `const char *`.
+    auto getProxiedTypeString = [this](const QualifiedType &original, const QualifiedType &proxied) {
+        if (original.baseType == Type::CppStdString)
+            return std::string{"[*:0]const u8"};
+        return getTypeString(proxied);
+    };
+
+    out << std::format(R"({}extern fn @"{}"()", std::string(m_indentationDepth, '\t'), proxy.mangledName);
+    std::string params;
+    for (size_t i = 0; i < proxy.parameters.size(); ++i)
+        params += proxy.parameters[i].name + ": " +
+                  getProxiedTypeString(function.parameters[i].type, proxy.parameters[i].type) + ", ";
+    out << params.substr(0, params.size() - 2) << ") " << getProxiedTypeString(function.returnType, proxy.returnType)
+        << ";\n";
+
+    out << std::string(m_indentationDepth, '\t') << "pub fn " << function.functionName << '(';
+    params.clear();
+    for (const auto &param : function.parameters)
+    {
+        params += param.name + ": ";
+        if (param.type.baseType == Type::CppStdString)
+            params += "[*:0]const u8";
+        else if (Utils::isContainerType(param.type.baseType))
+            // Only non-const references may be modified by C++; everything else is lent out read-only.
+            params += std::string(param.type.isReference && !param.type.isConst ? "*" : "*const ") +
+                      Utils::getHandleName(param.type);
+        else
+            params += getTypeString(param.type);
+        params += ", ";
+    }
+    out << params.substr(0, params.size() - 2) << ") ";
+
+    if (function.returnType.baseType == Type::CppStdString)
+        out << "[*:0]const u8";
+    else
+        out << getTypeString(function.returnType);
+    out << " {\n" << std::string(m_indentationDepth + 1, '\t');
+
+    if (function.returnType.baseType != Type::Void)
+        out << "return ";
+    // Unlike containers, a std::unique_ptr may be null.
+    const auto isReturnHandle = Utils::isContainerType(function.returnType.baseType) ||
+                                function.returnType.baseType == Type::CppStdUniquePtr;
+    if (function.returnType.baseType == Type::CppStdSharedPtr)
+        out << Utils::getHandleName(function.returnType) << ".init(";
+    else if (isReturnHandle)
+        out << ".{ .ptr = ";
+    out << std::format(R"(@"{}"()", proxy.mangledName);
+    params.clear();
+    for (const auto &param : function.parameters)
+    {
+        const auto isHandle =
+            Utils::isContainerType(param.type.baseType) || param.type.baseType == Type::CppStdUniquePtr;
+        params += param.name + (isHandle ? ".ptr" : "") + ", ";
+    }
+    out << params.substr(0, params.size() - 2) << ')';
+    if (function.returnType.baseType == Type::CppStdSharedPtr)
+        out << ".?)";
+    else if (isReturnHandle)
+        out << (function.returnType.baseType == Type::CppStdUniquePtr ? " }" : ".? }");
+    out << ";\n" << std::string(m_indentationDepth, '\t') << "}\n\n";
+}
+
+void ZigWrapperWriter::writeVectorHandle(const polyglot::QualifiedType &vectorType, std::ostream &out) const
+{
+    out << std::format(R"(// Owning handle for a std::vector<{1}> that lives in C++. slice() does not copy the elements; call deinit() to free
+// the vector through C++.
+pub const {0} = struct {{
+	ptr: *anyopaque,
+
+	pub fn fromSlice(data: []const {1}) {0} {{
+		return .{{ .ptr = {3}(data.ptr, data.len) }};
+	}}
+
+	pub fn slice(self: {0}) []{1} {{
+		const size = {5}(self.ptr);
+		const data = {4}(self.ptr) orelse return &[_]{1}{{}};
+		return data[0..size];
+	}}
+
+	pub fn deinit(self: {0}) void {{
+		{2}(self.ptr);
+	}}
+}};
+
+extern fn {4}(v: *anyopaque) ?[*]{1};
+extern fn {5}(v: *const anyopaque) usize;
+extern fn {2}(v: *anyopaque) void;
+extern fn {3}(data: [*]const {1}, size: usize) *anyopaque;
+
+)",
+                       Utils::getHandleName(vectorType),
+                       getTypeString(vectorType.templateArguments.at(0)),
+                       Utils::getHelperName(vectorType, "delete"),
+                       Utils::getHelperName(vectorType, "from"),
+                       Utils::getHelperName(vectorType, "data"),
+                       Utils::getHelperName(vectorType, "size"));
+}
+
 std::string ZigWrapperWriter::getTypeString(const QualifiedType &type) const
 {
     std::string typeString;
-    if (type.isConst)
-        typeString += "const ";
-    if (type.isReference)
-        throw std::runtime_error("Zig not have reference keywords");
     if (type.isPointer)
-        typeString += "?*";
+        typeString += type.isConst ? "?*const " : "?*";
+    else if (type.isReference || type.isRvalueReference)
+        // C++ references are passed as pointers, but unlike pointers they can never be null. An object passed as an rvalue
+        // reference is left in its moved-from state, so it still has to be deinitialized afterwards.
+        typeString += type.isConst ? "*const " : "*";
+    const auto pointerSize = typeString.size();
 
     // Ptr format: C-like (T*), Zig (*T)
     // zig ptr not infer nullable, only optional or c-ptr:
@@ -210,7 +406,7 @@ std::string ZigWrapperWriter::getTypeString(const QualifiedType &type) const
         typeString += "bool";
         break;
     case Type::Void:
-        typeString += "void";
+        typeString += type.isPointer || type.isReference ? "anyopaque" : "void";
         break;
     case Type::Char:
         typeString += "u8";// "char";
@@ -267,24 +463,61 @@ std::string ZigWrapperWriter::getTypeString(const QualifiedType &type) const
         else
             typeString += type.nameString;
         break;
+    case Type::Vector:
+        typeString += std::format("@Vector({}, {})", type.elementCount, getTypeString(type.templateArguments.at(0)));
+        break;
     case Type::CppStdString:
         typeString += "basic_string";
         break;
+    case Type::CppStdVector:
+    case Type::CppStdMap:
+    case Type::CppStdUnorderedMap:
+    case Type::CppStdFuture:
+    case Type::CppStdUniquePtr:
+    case Type::CppStdSharedPtr:
+    case Type::CppStdOptional:
+        typeString += Utils::getHandleName(type);
+        break;
+    case Type::CppStdMemoryResource:
+        // Memory resources are opaque; see PolyglotMemoryResource.ptr.
+        typeString += "anyopaque";
+        break;
+    case Type::FunctionPointer:
+    {
+        // C++ function pointers may be null, so they are optional.
+        std::string params;
+        for (auto it = type.templateArguments.cbegin() + 1; it != type.templateArguments.cend(); ++it)
+            params += getTypeString(*it) + ", ";
+        typeString += "?*const fn (" + params.substr(0, params.size() - 2) + ") callconv(.C) " +
+                      getTypeString(type.templateArguments.at(0));
+        break;
+    }
     case Type::Undefined:
     default:
         throw std::runtime_error("Undefined type in ZigWrapperWriter::getTypeString()");
         break;
     }
 
+    // The extents of an array of pointers come before the pointer, those of a pointer to an array after it.
+    std::string extents;
+    for (const auto extent : type.arrayExtents)
+        extents += std::format("[{}]", extent);
+    typeString.insert(type.isArray ? 0 : pointerSize, extents);
+
     return typeString;
 }
 
+std::string ZigWrapperWriter::getConstantString(const VariableNode &constant) const
+{
+    return std::format("pub const {}: {} = {};", constant.name, getTypeString(constant.type), getValueString(*constant.value));
+}
+
 std::string ZigWrapperWriter::getValueString(const Value &value) const
 {
     switch (value.type)
     {
     case Type::Bool:
-        return std::to_string(std::get<bool>(value.value));
+        return std::get<bool>(value.value) ? "true" : "false";
         break;
     case Type::Char:
         return std::to_string(std::get<char>(value.value));
@@ -309,7 +542,7 @@ std::string ZigWrapperWriter::getValueString(const Value &value) const
         break;
     case Type::Float32:
     case Type::Float64:
-        return std::to_string(std::get<double>(value.value));
+        return Utils::getFloatLiteral(std::get<double>(value.value));
         break;
     case Type::Enum:
     case Type::Class:
@@ -328,3 +561,522 @@ std::string ZigWrapperWriter::getValueString(const Value &value) const
         break;
     }
 }
+
+void ZigWrapperWriter::writeFutureHandle(const polyglot::QualifiedType &futureType, std::ostream &out) const
+{
+    out << std::format(R"(// Owning handle for a std::future<{1}> that lives in C++. Instead of blocking in get(), an event loop can register a
+// callback with onReady() that C++ calls once the result is ready, so a single thread can wait for any number of futures.
+// Call deinit() to free the future through C++.
+pub const {0} = struct {{
+	ptr: *anyopaque,
+
+	pub fn ready(self: {0}) bool {{
+		return {3}(self.ptr);
+	}}
+
+	// The callback is called once, from a C++ thread, and must not use this handle.
+	pub fn onReady(self: {0}, callback: *const fn (?*anyopaque) callconv(.C) void, context: ?*anyopaque) void {{
+		{4}(self.ptr, callback, context);
+	}}
+
+	// Waits for the result if it isn't ready yet. This can only be called once.
+	pub fn get(self: {0}) {1} {{
+		return {5}(self.ptr);
+	}}
+
+	pub fn deinit(self: {0}) void {{
+		{2}(self.ptr);
+	}}
+}};
+
+extern fn {3}(f: *const anyopaque) bool;
+extern fn {4}(f: *const anyopaque, callback: *const fn (?*anyopaque) callconv(.C) void, context: ?*anyopaque) void;
+extern fn {5}(f: *anyopaque) {1};
+extern fn {2}(f: *anyopaque) void;
+
+)",
+                       Utils::getHandleName(futureType),
+                       getTypeString(futureType.templateArguments.at(0)),
+                       Utils::getHelperName(futureType, "delete"),
+                       Utils::getHelperName(futureType, "ready"),
+                       Utils::getHelperName(futureType, "notify"),
+                       Utils::getHelperName(futureType, "get"));
+}
+
+void ZigWrapperWriter::writeUniquePtrHandle(const polyglot::QualifiedType &uniquePtrType, std::ostream &out) const
+{
+    out << std::format(R"(// Owning handle for a std::unique_ptr<{1}>. It is only the pointer, so it is passed to and from C++ as cheaply as a raw
+// one. Call deinit() to free the pointee through C++, unless the handle was passed to a function that took it over.
+pub const {0} = extern struct {{
+	ptr: ?*{1},
+
+	pub fn deinit(self: {0}) void {{
+		if (self.ptr) |p| {2}(p);
+	}}
+}};
+
+extern fn {2}(p: *{1}) void;
+
+)",
+                       Utils::getHandleName(uniquePtrType),
+                       getTypeString(uniquePtrType.templateArguments.at(0)),
+                       Utils::getHelperName(uniquePtrType, "delete"));
+}
+
+void ZigWrapperWriter::writeSharedPtrHandle(const polyglot::QualifiedType &sharedPtrType, std::ostream &out) const
+{
+    out << std::format(R"(// Owning handle for a std::shared_ptr<{1}> that lives in C++. clone() shares ownership like copying the shared_ptr
+// does. The handle keeps the pointee, so get() borrows it without touching the reference count; use it to pass the
+// pointee to functions that take a pointer or a reference. Call deinit() to free the shared_ptr through C++.
+pub const {0} = struct {{
+	ptr: *anyopaque,
+	raw: ?*{1},
+
+	pub fn init(ptr: *anyopaque) {0} {{
+		return .{{ .ptr = ptr, .raw = {2}(ptr) }};
+	}}
+
+	pub fn clone(self: {0}) {0} {{
+		return .{{ .ptr = {3}(self.ptr), .raw = self.raw }};
+	}}
+
+	pub fn get(self: {0}) ?*{1} {{
+		return self.raw;
+	}}
+
+	pub fn deinit(self: {0}) void {{
+		{4}(self.ptr);
+	}}
+}};
+
+extern fn {2}(p: *const anyopaque) ?*{1};
+extern fn {3}(p: *const anyopaque) *anyopaque;
+extern fn {4}(p: *anyopaque) void;
+
+)",
+                       Utils::getHandleName(sharedPtrType),
+                       getTypeString(sharedPtrType.templateArguments.at(0)),
+                       Utils::getHelperName(sharedPtrType, "get"),
+                       Utils::getHelperName(sharedPtrType, "clone"),
+                       Utils::getHelperName(sharedPtrType, "delete"));
+}
+
+void ZigWrapperWriter::writeOptional(const polyglot::QualifiedType &optionalType, std::ostream &out) const
+{
+    out << std::format(R"(// A std::optional<{1}>. It has the same layout, so it is passed by value without any conversion.
+pub const {0} = extern struct {{
+	value: {1} = undefined,
+	has_value: bool = false,
+
+	pub const none: {0} = .{{}};
+
+	pub fn some(value: {1}) {0} {{
+		return .{{ .value = value, .has_value = true }};
+	}}
+
+	pub fn get(self: {0}) ?{1} {{
+		return if (self.has_value) self.value else null;
+	}}
+}};
+
+)",
+                       Utils::getHandleName(optionalType),
+                       getTypeString(optionalType.templateArguments.at(0)));
+}
+
+void ZigWrapperWriter::writeMemoryResource(std::ostream &out) const
+{
+    out << R"(// A std::pmr::memory_resource that allocates from a Zig allocator (e.g. an arena), for functions that take a
+// std::pmr::memory_resource *. The allocator has to outlive the resource and everything that C++ allocated from it. Call
+// deinit() to free the resource through C++.
+pub const PolyglotMemoryResource = struct {
+	ptr: *anyopaque,
+
+	pub fn init(allocator: *const @import("std").mem.Allocator) PolyglotMemoryResource {
+		return .{ .ptr = polyglot_memory_resource_new(allocate, deallocate, @constCast(allocator)) };
+	}
+
+	pub fn deinit(self: PolyglotMemoryResource) void {
+		polyglot_memory_resource_delete(self.ptr);
+	}
+
+	fn allocate(context: *anyopaque, size: usize, alignment: usize) callconv(.C) ?*anyopaque {
+		const allocator: *const @import("std").mem.Allocator = @ptrCast(@alignCast(context));
+		return @ptrCast(allocator.rawAlloc(size, @intCast(@ctz(alignment)), @returnAddress()));
+	}
+
+	fn deallocate(context: *anyopaque, p: *anyopaque, size: usize, alignment: usize) callconv(.C) void {
+		const allocator: *const @import("std").mem.Allocator = @ptrCast(@alignCast(context));
+		const bytes: [*]u8 = @ptrCast(p);
+		allocator.rawFree(bytes[0..size], @intCast(@ctz(alignment)), @returnAddress());
+	}
+};
+
+extern fn polyglot_memory_resource_new(allocate: *const fn (*anyopaque, usize, usize) callconv(.C) ?*anyopaque, deallocate: *const fn (*anyopaque, *anyopaque, usize, usize) callconv(.C) void, context: *anyopaque) *anyopaque;
+extern fn polyglot_memory_resource_delete(resource: *anyopaque) void;
+
+)";
+}
+
+void ZigWrapperWriter::writeMapHandle(const polyglot::QualifiedType &mapType, std::ostream &out) const
+{
+    out << std::format(R"(// Owning handle for a {1}<{2}, {3}> that lives in C++. iterator() copies entries out in chunks that fit the
+// given buffers; call deinit() to free the map through C++.
+pub const {0} = struct {{
+	ptr: *anyopaque,
+
+	pub fn init() {0} {{
+		return .{{ .ptr = {5}() }};
+	}}
+
+	pub fn len(self: {0}) usize {{
+		return {6}(self.ptr);
+	}}
+
+	pub fn insert(self: {0}, key: {2}, value: {3}) void {{
+		{7}(self.ptr, key, value);
+	}}
+
+	pub fn iterator(self: {0}, keys: []{2}, values: []{3}) {4} {{
+		return {4}.init({9}(self.ptr), {10}, {11}, keys, values);
+	}}
+
+	pub fn deinit(self: {0}) void {{
+		{8}(self.ptr);
+	}}
+}};
+
+extern fn {5}() *anyopaque;
+extern fn {6}(m: *const anyopaque) usize;
+extern fn {7}(m: *anyopaque, key: {2}, value: {3}) void;
+extern fn {8}(m: *anyopaque) void;
+extern fn {9}(m: *const anyopaque) *anyopaque;
+extern fn {10}(state: *anyopaque, keys: [*]{2}, values: [*]{3}, capacity: usize) usize;
+extern fn {11}(state: *anyopaque) void;
+
+)",
+                       Utils::getHandleName(mapType),
+                       mapType.baseType == Type::CppStdMap ? "std::map" : "std::unordered_map",
+                       getTypeString(mapType.templateArguments.at(0)),
+                       getTypeString(mapType.templateArguments.at(1)),
+                       Utils::getIteratorName(mapType.templateArguments),
+                       Utils::getHelperName(mapType, "new"),
+                       Utils::getHelperName(mapType, "size"),
+                       Utils::getHelperName(mapType, "insert"),
+                       Utils::getHelperName(mapType, "delete"),
+                       Utils::getHelperName(mapType, "iter_begin"),
+                       Utils::getHelperName(mapType, "iter_next"),
+                       Utils::getHelperName(mapType, "iter_free"));
+}
+
+void ZigWrapperWriter::writeIterator(const std::vector<polyglot::QualifiedType> &itemTypes, std::ostream &out) const
+{
+    std::string itemType;
+    std::string bufferPointerTypes;
+    std::string bufferFields;
+    std::string bufferParams;
+    std::string bufferInits;
+    std::string bufferArgs;
+    std::string capacity = "self.buffer0.len";
+    std::string item;
+    for (size_t i = 0; i < itemTypes.size(); ++i)
+    {
+        const auto type = getTypeString(itemTypes[i]);
+        bufferPointerTypes += std::format("[*]{}, ", type);
+        bufferFields += std::format("\tbuffer{}: []{},\n", i, type);
+        bufferParams += std::format("buffer{}: []{}, ", i, type);
+        bufferInits += std::format(".buffer{0} = buffer{0}, ", i);
+        bufferArgs += std::format("self.buffer{}.ptr, ", i);
+        if (i > 0)
+            capacity = std::format("@min({}, self.buffer{}.len)", capacity, i);
+    }
+    if (itemTypes.size() == 2)
+    {
+        itemType = std::format("struct {{ key: {}, value: {} }}",
+                               getTypeString(itemTypes[0]),
+                               getTypeString(itemTypes[1]));
+        item = ".{ .key = self.buffer0[self.position], .value = self.buffer1[self.position] }";
+    }
+    else
+    {
+        itemType = getTypeString(itemTypes.at(0));
+        item = "self.buffer0[self.position]";
+    }
+
+    out << std::format(R"(// Iterates over a C++ container, copying as many items out of C++ per boundary crossing as fit the buffers. The
+// iteration state is freed once next() returns null; call deinit() if the iteration is stopped early.
+pub const {0} = struct {{
+	pub const Item = {1};
+
+	state: ?*anyopaque,
+	nextChunk: *const fn (*anyopaque, {2}usize) callconv(.C) usize,
+	free: *const fn (*anyopaque) callconv(.C) void,
+{3}	position: usize = 0,
+	length: usize = 0,
+
+	pub fn init(state: *anyopaque, nextChunk: *const fn (*anyopaque, {2}usize) callconv(.C) usize, free: *const fn (*anyopaque) callconv(.C) void, {4}) {0} {{
+		return .{{ .state = state, .nextChunk = nextChunk, .free = free, {5}}};
+	}}
+
+	pub fn next(self: *{0}) ?Item {{
+		if (self.position == self.length) {{
+			const state = self.state orelse return null;
+			self.position = 0;
+			self.length = self.nextChunk(state, {6}{7});
+			if (self.length == 0) {{
+				self.deinit();
+				return null;
+			}}
+		}}
+		defer self.position += 1;
+		return {8};
+	}}
+
+	pub fn deinit(self: *{0}) void {{
+		if (self.state) |state| self.free(state);
+		self.state = null;
+	}}
+}};
+
+)",
+                       Utils::getIteratorName(itemTypes),
+                       itemType,
+                       bufferPointerTypes,
+                       bufferFields,
+                       bufferParams.substr(0, bufferParams.size() - 2),
+                       bufferInits,
+                       bufferArgs,
+                       capacity,
+                       item);
+}
+
+void ZigWrapperWriter::writeClassIterator(const polyglot::ClassNode &classNode, std::ostream &out) const
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+    const auto iterator = Utils::getIteratorName({*classNode.iteratorValueType});
+    out << indent
+        << std::format("pub fn iterator(self: *{}, buffer: []{}) {} {{\n",
+                       classNode.name,
+                       getTypeString(*classNode.iteratorValueType),
+                       iterator)
+        << indent
+        << std::format("\treturn {}.init({}(self), {}, {}, buffer);\n",
+                       iterator,
+                       Utils::getClassHelperName(classNode, "iter_begin"),
+                       Utils::getClassHelperName(classNode, "iter_next"),
+                       Utils::getClassHelperName(classNode, "iter_free"))
+        << indent << "}\n";
+}
+
+void ZigWrapperWriter::writeClassIteratorHelpers(const polyglot::ClassNode &classNode, std::ostream &out) const
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent
+        << std::format("extern fn {}(c: *{}) *anyopaque;\n", Utils::getClassHelperName(classNode, "iter_begin"), classNode.name)
+        << indent
+        << std::format("extern fn {}(state: *anyopaque, values: [*]{}, capacity: usize) usize;\n",
+                       Utils::getClassHelperName(classNode, "iter_next"),
+                       getTypeString(*classNode.iteratorValueType))
+        << indent
+        << std::format("extern fn {}(state: *anyopaque) void;\n\n", Utils::getClassHelperName(classNode, "iter_free"));
+}
+
+void ZigWrapperWriter::writeCallbackFunction(const polyglot::FunctionNode &function, std::ostream &out) const
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+
+    std::string params;
+    std::string args;
+    std::string trampolines;
+    for (size_t i = 0; i < function.parameters.size(); ++i)
+    {
+        const auto &param = function.parameters[i];
+        if (!Utils::isCallbackParameter(function, i))
+        {
+            params += param.name + ": " + getTypeString(param.type) + ", ";
+            args += param.name + ", ";
+            continue;
+        }
+
+        // Zig has no closures, so a callback is any pointer to a value with a `call` method. The pointer itself is passed
+        // as the context and a trampoline generated for its type calls the method, so the value must stay alive for as
+        // long as C++ may call it.
+        const auto &signature = param.type.templateArguments;
+        std::string trampolineParams;
+        std::string trampolineArgs;
+        for (size_t j = 1; j + 1 < signature.size(); ++j)
+        {
+            trampolineParams += std::format("a{}: {}, ", j - 1, getTypeString(signature[j]));
+            trampolineArgs += std::format("a{}, ", j - 1);
+        }
+        params += param.name + ": anytype, ";
+        args += std::format("&trampoline{}, @ptrCast({}), ", i, param.name);
+        // The trampoline can't refer to the parameter itself, only to its type.
+        trampolines += indent + std::format("\tconst Callback{} = @TypeOf({});\n", i, param.name) + indent +
+                       std::format("\tconst trampoline{} = struct {{\n", i) + indent +
+                       std::format("\t\tfn call({}context: ?*anyopaque) callconv(.C) {} {{\n",
+                                   trampolineParams,
+                                   getTypeString(signature.front())) +
+                       indent + std::format("\t\t\tconst callback: Callback{} = @ptrCast(@alignCast(context));\n", i) +
+                       indent + "\t\t\treturn callback.call(" + trampolineArgs.substr(0, trampolineArgs.size() - 2) + ");\n" +
+                       indent + "\t\t}\n" + indent + "\t}.call;\n";
+        ++i; // The context pointer is filled in by the wrapper.
+    }
+
+    out << indent << "pub fn " << function.functionName << '(' << params.substr(0, params.size() - 2) << ") "
+        << getTypeString(function.returnType) << " {\n"
+        << trampolines
+        << indent << std::format(R"(	return @"{}"({});)", Utils::getSymbolName(function), args.substr(0, args.size() - 2))
+        << "\n" << indent << "}\n\n";
+}
+
+void ZigWrapperWriter::writeBatchFunction(const polyglot::FunctionNode &function, std::ostream &out) const
+{
+    const auto hasResults = function.returnType.baseType != Type::Void;
+    const auto symbol = Utils::getBatchSymbolName(function);
+    // All slices have to be as long as the first one; with results, that's the results slice.
+    const auto countSource = hasResults ? std::string{"results"} : function.parameters.at(0).name;
+
+    std::string externParams;
+    std::string params;
+    std::string checks;
+    std::string args;
+    for (const auto &param : function.parameters)
+    {
+        externParams += param.name + ": [*]const " + getTypeString(param.type) + ", ";
+        params += param.name + ": []const " + getTypeString(param.type) + ", ";
+        if (param.name != countSource)
+            checks += param.name + ".len != " + countSource + ".len or ";
+        args += param.name + ".ptr, ";
+    }
+    if (hasResults)
+    {
+        externParams += "results: [*]" + getTypeString(function.returnType) + ", ";
+        params += "results: []" + getTypeString(function.returnType) + ", ";
+        args += "results.ptr, ";
+    }
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent << std::format(R"(extern fn @"{}"({}count: usize) void;)", symbol, externParams) << '\n';
+
+    // Calls the function once for each set of arguments, crossing into C++ only once for the whole batch.
+    out << indent << "pub fn " << function.functionName << "_batch(" << params.substr(0, params.size() - 2)
+        << ") void {\n";
+    if (!checks.empty())
+        out << indent << "\tif (" << checks.substr(0, checks.size() - 4)
+            << std::format(R"() @panic("All batch slices passed to {}_batch must have the same length");)",
+                           function.functionName)
+            << '\n';
+    out << indent << std::format(R"(	@"{}"({}{}.len);)", symbol, args, countSource) << '\n'
+        << indent << "}\n\n";
+}
+
+// Zig doesn't have overloading, so every constructor after the first one gets a numbered name.
+static std::string getConstructorSuffix(size_t i)
+{
+    return i == 0 ? std::string{} : std::to_string(i);
+}
+
+static std::vector<const FunctionNode *> getBoundConstructors(const ClassNode &classNode)
+{
+    std::vector<const FunctionNode *> ret;
+    // The layout is needed to reserve storage for the object, so there is nothing to construct without it.
+    if (classNode.size == 0)
+        return ret;
+    for (const auto &constructor : classNode.constructors)
+    {
+        if (!Utils::isCopyConstructor(classNode, constructor))
+            ret.push_back(&constructor);
+    }
+    return ret;
+}
+
+void ZigWrapperWriter::writeLifetimeFunctions(const polyglot::ClassNode &classNode, std::ostream &out) const
+{
+    const auto indent = std::string(m_indentationDepth, '\t');
+    const auto constructors = getBoundConstructors(classNode);
+    for (size_t i = 0; i < constructors.size(); ++i)
+    {
+        std::string params;
+        std::string args;
+        for (const auto &param : constructors[i]->parameters)
+        {
+            params += ", " + param.name + ": " + getTypeString(param.type);
+            args += ", " + param.name;
+        }
+        const auto ctor = std::format("polyglot_{}_ctor{}", classNode.name, getConstructorSuffix(i));
+
+        // The object is built directly in the caller's storage (e.g. a stack variable or an arena slot), so constructing
+        // it doesn't allocate.
+        out << indent
+            << std::format("pub fn initInPlace{}(self: *{}{}) void {{\n", getConstructorSuffix(i), classNode.name, params)
+            << indent << std::format("\t{}(self{});\n", ctor, args) << indent << "}\n\n";
+
+        // Returning by value moves the object, which is only safe if C++ would allow copying it byte by byte.
+        if (classNode.isTriviallyCopyable)
+            out << indent
+                << std::format("pub fn init{}({}) {} {{\n",
+                               getConstructorSuffix(i),
+                               params.empty() ? "" : params.substr(2),
+                               classNode.name)
+                << indent << std::format("\tvar self: {} = undefined;\n", classNode.name)
+                << indent << std::format("\t{}(&self{});\n", ctor, args) << indent << "\treturn self;\n"
+                << indent << "}\n\n";
+    }
+
+    if (classNode.destructor && classNode.size > 0)
+        out << indent << std::format("pub fn deinit(self: *{}) void {{\n", classNode.name)
+            << indent << std::format("\tpolyglot_{}_dtor(self);\n", classNode.name) << indent << "}\n\n";
+}
+
+void ZigWrapperWriter::writeLifetimeExterns(const polyglot::ClassNode &classNode, std::ostream &out) const
+{
+    const auto constructors = getBoundConstructors(classNode);
+    for (size_t i = 0; i < constructors.size(); ++i)
+    {
+        std::string params;
+        for (const auto &param : constructors[i]->parameters)
+            params += ", " + param.name + ": " + getTypeString(param.type);
+        out << std::format(R"(extern fn @"{}"(this: *{}{}) void;)", Utils::getSymbolName(*constructors[i]), classNode.name, params)
+            << '\n'
+            << std::format(R"(const polyglot_{}_ctor{} = @"{}";)",
+                           classNode.name,
+                           getConstructorSuffix(i),
+                           Utils::getSymbolName(*constructors[i]))
+            << "\n\n";
+    }
+
+    if (classNode.destructor && classNode.size > 0)
+        out << std::format(R"(extern fn @"{}"(this: *{}) void;)", Utils::getSymbolName(*classNode.destructor), classNode.name)
+            << '\n'
+            << std::format(R"(const polyglot_{}_dtor = @"{}";)", classNode.name, Utils::getSymbolName(*classNode.destructor))
+            << "\n\n";
+}
+
+void ZigWrapperWriter::writeLayoutAssertions(const polyglot::ClassNode &classNode, std::ostream &out) const
+{
+    if (classNode.size == 0 || classNode.members.empty())
+        return;
+
+    const auto indent = std::string(m_indentationDepth, '\t');
+    out << indent << "comptime {\n"
+        << indent
+        << std::format("\tif (@sizeOf({0}) != {1}) @compileError(\"size of {0} does not match C++\");\n",
+                       classNode.name,
+                       classNode.size)
+        << indent
+        << std::format("\tif (@alignOf({0}) != {1}) @compileError(\"alignment of {0} does not match C++\");\n",
+                       classNode.name,
+                       classNode.alignment);
+    for (const auto &member : classNode.members)
+    {
+        if (!member.offset)
+            continue;
+        out << indent
+            << std::format("\tif (@offsetOf({0}, \"{1}\") != {2}) @compileError(\"offset of {0}.{1} does not match C++\");\n",
+                           classNode.name,
+                           member.name,
+                           *member.offset);
+    }
+    out << indent << "}\n\n";
+}
@@ -16,5 +16,36 @@ protected:
     std::string getValueString(const polyglot::Value &value) const final;
 
 private:
+    void writeProxyFunction(const polyglot::FunctionNode &function, std::ostream &out);
+    //! Returns the definition of a compile-time constant.
+    std::string getConstantString(const polyglot::VariableNode &constant) const;
+    void writeVectorHandle(const polyglot::QualifiedType &vectorType, std::ostream &out) const;
+    void writeMapHandle(const polyglot::QualifiedType &mapType, std::ostream &out) const;
+    void writeFutureHandle(const polyglot::QualifiedType &futureType, std::ostream &out) const;
+    void writeUniquePtrHandle(const polyglot::QualifiedType &uniquePtrType, std::ostream &out) const;
+    void writeSharedPtrHandle(const polyglot::QualifiedType &sharedPtrType, std::ostream &out) const;
+    void writeOptional(const polyglot::QualifiedType &optionalType, std::ostream &out) const;
+    void writeMemoryResource(std::ostream &out) const;
+    void writeIterator(const std::vector<polyglot::QualifiedType> &itemTypes, std::ostream &out) const;
+    //! Writes an iterator() method for a class that can be iterated over with begin() and end().
+    void writeClassIterator(const polyglot::ClassNode &classNode, std::ostream &out) const;
+    //! Declares the C helpers behind writeClassIterator().
+    void writeClassIteratorHelpers(const polyglot::ClassNode &classNode, std::ostream &out) const;
+
+    //! Writes init functions that construct the object in place and a deinit function that calls the destructor. This
+    //! has to be called from inside the struct.
+    void writeLifetimeFunctions(const polyglot::ClassNode &classNode, std::ostream &out) const;
+    //! Declares the constructors and destructor behind writeLifetimeFunctions().
+    void writeLifetimeExterns(const polyglot::ClassNode &classNode, std::ostream &out) const;
+
+    //! Writes compile-time assertions that the struct generated for `classNode` has the same layout as the C++ class.
+    void writeLayoutAssertions(const polyglot::ClassNode &classNode, std::ostream &out) const;
+    //! Writes the wrapper for a function that takes callbacks (see Utils::hasCallbackParameters()), which takes a pointer
+    //! to a value with a `call` method for each callback and context pair of `function`. `function` has to be the
+    //! declaration returned by Utils::getCallbackBinding().
+    void writeCallbackFunction(const polyglot::FunctionNode &function, std::ostream &out) const;
+    //! Writes the slice-based wrapper for a function annotated with "polyglot::batch".
+    void writeBatchFunction(const polyglot::FunctionNode &function, std::ostream &out) const;
+
     int16_t m_indentationDepth = 0;
 };
@@ -5,11 +5,15 @@
 
 #include "CppParser.h"
 
+#include <algorithm>
 #include <format>
 #include <fstream>
 #include <iostream>
 
 #include <clang/AST/Mangle.h>
+#include <clang/AST/QualTypeNames.h>
+#include <clang/AST/RecordLayout.h>
+#include <clang/AST/VTableBuilder.h>
 
 #include "CppTypeProxyWriter.h"
 #include "CppUtils.h"
@@ -28,13 +32,31 @@ polyglot::Value getExprValue(const clang::Expr *defaultValue, const clang::ASTCo
     Value ret;
     if (result.Val.isInt())
     {
-        ret.type = Type::Int64;
-        ret.value = result.Val.getInt().getExtValue();
+        const auto &value = result.Val.getInt();
+        if (defaultValue->getType()->isBooleanType())
+        {
+            ret.type = Type::Bool;
+            ret.value = value.getBoolValue();
+        }
+        else if (value.isUnsigned())
+        {
+            ret.type = Type::Uint64;
+            ret.value = value.getZExtValue();
+        }
+        else
+        {
+            ret.type = Type::Int64;
+            ret.value = value.getExtValue();
+        }
     }
     else if (result.Val.isFloat())
     {
+        // convertToDouble() only works on doubles, so floats have to be widened first.
+        auto value = result.Val.getFloat();
+        bool losesInfo = false;
+        value.convert(llvm::APFloat::IEEEdouble(), llvm::APFloat::rmNearestTiesToEven, &losesInfo);
         ret.type = Type::Float64;
-        ret.value = result.Val.getFloat().convertToDouble();
+        ret.value = value.convertToDouble();
     }
     else if (result.Val.isNullPointer()) // TODO: integrate this case with the wrappers
     {
@@ -45,6 +67,57 @@ polyglot::Value getExprValue(const clang::Expr *defaultValue, const clang::ASTCo
     return ret;
 }
 
+//! Whether the function is declared to never throw (e.g. noexcept or noexcept(true)).
+static bool isNothrow(const clang::FunctionDecl *function)
+{
+    const auto proto = function->getType()->getAs<clang::FunctionProtoType>();
+    return proto && proto->isNothrow();
+}
+
+//! Returns the fixed-width integer type with the same size and signedness as the underlying type of the enum, so that
+//! the bindings can give the enum the same representation. The type is Undefined if the underlying type isn't known.
+static polyglot::QualifiedType getEnumTagType(const clang::EnumDecl *e)
+{
+    using polyglot::Type;
+
+    polyglot::QualifiedType ret;
+    const auto integerType = e->getIntegerType();
+    if (integerType.isNull())
+        return ret;
+
+    // bool and the char types are allowed as underlying types too; they are represented by an integer of the same size.
+    const auto isSigned = integerType->isSignedIntegerType();
+    switch (e->getASTContext().getTypeSize(integerType))
+    {
+    case 8:
+        ret.baseType = isSigned ? Type::Int8 : Type::Uint8;
+        break;
+    case 16:
+        ret.baseType = isSigned ? Type::Int16 : Type::Uint16;
+        break;
+    case 32:
+        ret.baseType = isSigned ? Type::Int32 : Type::Uint32;
+        break;
+    case 64:
+        ret.baseType = isSigned ? Type::Int64 : Type::Uint64;
+        break;
+    case 128:
+        ret.baseType = isSigned ? Type::Int128 : Type::Uint128;
+        break;
+    }
+    return ret;
+}
+
+//! Whether the function returns a class by value that C++ returns through a hidden pointer to caller storage.
+static bool needsReturnSlot(const clang::FunctionDecl *function, const polyglot::QualifiedType &returnType)
+{
+    if (returnType.baseType != polyglot::Type::Class || returnType.isPointer || returnType.isReference)
+        return false;
+    const auto classType = function->getReturnType()->getAsCXXRecordDecl();
+    return classType && classType->hasDefinition() &&
+           !(classType->isTriviallyCopyable() && classType->canPassInRegisters());
+}
+
 CppParser::CppParser(std::vector<polyglot::Language> languages, std::string outputDir)
     : m_langs{languages},
       m_outputDir{outputDir}
@@ -65,10 +138,25 @@ void CppParser::addFunction(const clang::FunctionDecl *function, const std::stri
     ast.language = polyglot::Language::Cpp;
 
     auto functionNode = new polyglot::FunctionNode;
-    functionNode->functionName = function->getNameAsString();
+    functionNode->functionName = CppUtils::getBindingName(function);
+    if (const auto templateArguments = CppUtils::getTemplateArgumentsString(function); !templateArguments.empty())
+        functionNode->cppName = function->getNameAsString() + templateArguments;
     functionNode->mangledName = mangledName;
     functionNode->returnType = typeFromClangType(function->getReturnType(), function);
+    functionNode->hasReturnSlot = needsReturnSlot(function, functionNode->returnType);
     functionNode->isNoreturn = function->isNoReturn();
+    functionNode->isNothrow = isNothrow(function);
+    functionNode->isPure = function->hasAttr<clang::PureAttr>();
+    functionNode->isConstFunction = function->hasAttr<clang::ConstAttr>();
+    // Functions that are inline (including constexpr ones) or have internal linkage don't necessarily emit a symbol.
+    // Explicit instantiations are emitted even if they are inline.
+    functionNode->isInline = (function->isInlined() && !CppUtils::isExplicitInstantiation(function)) ||
+                             !function->isExternallyVisible();
+    for (const auto attr : function->specific_attrs<clang::AnnotateAttr>())
+    {
+        if (attr->getAnnotation() == "polyglot::batch")
+            functionNode->isBatched = true;
+    }
     for (const auto &param : function->parameters())
     {
         polyglot::VariableNode p;
@@ -79,6 +167,38 @@ void CppParser::addFunction(const clang::FunctionDecl *function, const std::stri
         functionNode->parameters.push_back(p);
     }
 
+    if (functionNode->isBatched)
+    {
+        // Batches are passed as plain arrays, so everything has to be a value that can be stored in one.
+        auto isBatchable = [](const polyglot::QualifiedType &type) {
+            return type.baseType >= polyglot::Type::Bool && type.baseType <= polyglot::Type::Enum && !type.isPointer &&
+                   !type.isReference && !type.isRvalueReference;
+        };
+        if (functionNode->parameters.empty())
+            throw std::runtime_error("polyglot::batch requires the function to have at least one parameter");
+        if ((functionNode->returnType.baseType != polyglot::Type::Void && !isBatchable(functionNode->returnType)) ||
+            std::any_of(functionNode->parameters.cbegin(), functionNode->parameters.cend(), [&isBatchable](const auto &p) {
+                return !isBatchable(p.type);
+            }))
+            throw std::runtime_error("polyglot::batch is only supported for functions that take and return builtin types "
+                                     "or enums by value");
+    }
+
+    if (Utils::hasCallbackParameters(*functionNode))
+    {
+        // The bindings wrap the function to turn closures into callbacks, so it can't need any other kind of wrapper.
+        auto needsWrapper = [](const polyglot::VariableNode &p) {
+            return Utils::isConsumedParameter(p) ||
+                   (p.type.baseType >= polyglot::Type::CppStdString && p.type.baseType != polyglot::Type::CppStdFunction &&
+                    p.type.baseType != polyglot::Type::FunctionPointer);
+        };
+        if (functionNode->hasReturnSlot || functionNode->isBatched ||
+            (functionNode->returnType.baseType >= polyglot::Type::CppStdString) ||
+            std::any_of(functionNode->parameters.cbegin(), functionNode->parameters.cend(), needsWrapper))
+            throw std::runtime_error("Functions that take callbacks can only take and return other values that are passed "
+                                     "like in C");
+    }
+
     pushNodeToProperNS(ast, function, functionNode);
 }
 
@@ -91,6 +211,7 @@ void CppParser::addEnum(const clang::EnumDecl *e, const std::string &filename)
 
     auto enumNode = new polyglot::EnumNode;
     enumNode->enumName = e->getNameAsString();
+    enumNode->tagType = getEnumTagType(e);
     for (const auto &enumerator : e->enumerators())
     {
         // so many enum type names!
@@ -104,6 +225,81 @@ void CppParser::addEnum(const clang::EnumDecl *e, const std::string &filename)
     pushNodeToProperNS(ast, e, enumNode);
 }
 
+void CppParser::addVariable(const clang::VarDecl *variable, const std::string &filename)
+{
+    auto moduleName = Utils::getModuleName(filename);
+    if (variable->isConstexpr())
+    {
+        auto constant = constantFromVarDecl(variable);
+        if (!constant)
+            return;
+
+        auto &ast = m_asts[moduleName];
+        ast.moduleName = moduleName;
+        ast.language = polyglot::Language::Cpp;
+        pushNodeToProperNS(ast, variable, new polyglot::VariableNode{*constant});
+        return;
+    }
+
+    if (variable->getTLSKind() != clang::VarDecl::TLS_None)
+        throw std::runtime_error("thread_local variables can't be bound directly");
+
+    auto mangler = variable->getASTContext().createMangleContext();
+    std::string mangledName;
+    llvm::raw_string_ostream buf(mangledName);
+    mangler->mangleName(variable, buf);
+    buf.flush();
+    delete mangler;
+
+    auto &ast = m_asts[moduleName];
+    ast.moduleName = moduleName;
+    ast.language = polyglot::Language::Cpp;
+
+    auto variableNode = new polyglot::VariableNode;
+    variableNode->name = variable->getNameAsString();
+    variableNode->mangledName = mangledName;
+    variableNode->type = typeFromClangType(variable->getType(), variable);
+    variableNode->isInline = variable->isInline();
+
+    // The bindings refer to the variable's storage directly, so it has to be something they can lay out themselves.
+    if (variableNode->type.isReference || variableNode->type.isRvalueReference ||
+        (variableNode->type.baseType >= polyglot::Type::CppStdString &&
+         variableNode->type.baseType != polyglot::Type::FunctionPointer))
+        throw std::runtime_error("Only variables of builtin types, enums, pointers and classes can be bound directly");
+
+    pushNodeToProperNS(ast, variable, variableNode);
+}
+
+std::optional<polyglot::VariableNode> CppParser::constantFromVarDecl(const clang::VarDecl *variable) const
+{
+    using polyglot::Type;
+
+    if (!variable->isConstexpr() || !variable->getInit())
+        return std::nullopt;
+
+    polyglot::VariableNode constant;
+    constant.name = variable->getNameAsString();
+    try
+    {
+        constant.type = typeFromClangType(variable->getType(), variable);
+    }
+    catch (const std::runtime_error &)
+    {
+        return std::nullopt;
+    }
+
+    const auto &type = constant.type;
+    if (type.isPointer || type.isReference || type.isArray || type.baseType < Type::Bool || type.baseType > Type::Float64 ||
+        type.baseType == Type::Int128 || type.baseType == Type::Uint128)
+        return std::nullopt;
+
+    // A constant is const by definition, which the bindings express through how they declare it.
+    constant.type.isConst = false;
+    constant.isConstexpr = true;
+    constant.value = getExprValue(variable->getInit(), variable->getASTContext());
+    return constant;
+}
+
 void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::string &filename)
 {
     auto moduleName = Utils::getModuleName(filename);
@@ -112,7 +308,8 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
     ast.language = polyglot::Language::Cpp;
 
     auto classNode = new polyglot::ClassNode;
-    classNode->name = classDecl->getNameAsString();
+    classNode->name = CppUtils::getBindingName(classDecl);
+    classNode->qualifiedName = CppUtils::getQualifiedCppName(classDecl);
     if (classDecl->isClass())
         classNode->type = polyglot::ClassNode::Type::Class;
     else
@@ -121,6 +318,13 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
     std::unique_ptr<clang::MangleContext> mangler;
     mangler.reset(classDecl->getASTContext().createMangleContext());
 
+    // An explicit instantiation emits every member that the template defines, including the inline ones. Implicitly
+    // declared members are still only emitted where they are used.
+    const auto isExplicitInstantiation = CppUtils::isExplicitInstantiation(classDecl);
+    auto isInline = [isExplicitInstantiation](const clang::CXXMethodDecl *method) {
+        return method->isInlined() && (!isExplicitInstantiation || method->isImplicit());
+    };
+
     for (const auto &method : classDecl->methods())
     {
         if (method->isDeleted())
@@ -129,7 +333,13 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
         polyglot::FunctionNode functionNode;
         functionNode.functionName = method->getNameAsString();
         functionNode.isVirtual = method->isVirtual();
+        functionNode.isOverride = method->size_overridden_methods() > 0;
+        functionNode.isFinal = method->hasAttr<clang::FinalAttr>() || classDecl->hasAttr<clang::FinalAttr>();
         functionNode.isStatic = method->isStatic();
+        functionNode.isConst = method->isConst();
+        functionNode.isNothrow = isNothrow(method);
+        functionNode.isPure = method->hasAttr<clang::PureAttr>();
+        functionNode.isConstFunction = method->hasAttr<clang::ConstAttr>();
 
         for (const auto &param : method->parameters())
         {
@@ -143,16 +353,28 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
 
         if (const auto ctor = llvm::dyn_cast<clang::CXXConstructorDecl>(method); ctor)
         {
+            // Abstract classes can only be constructed as a base class, which the bindings don't support.
+            if (classDecl->isAbstract())
+                continue;
+
+            // The bindings construct whole objects in storage provided by the caller, so they need the complete-object
+            // constructor. Constructors that are inline or implicit may not be emitted at all, so they get a shim.
+            functionNode.isInline = isInline(ctor);
             llvm::raw_string_ostream buf{functionNode.mangledName};
-            mangler->mangleName(clang::GlobalDecl{ctor, clang::CXXCtorType::Ctor_Base}, buf);
+            mangler->mangleName(clang::GlobalDecl{ctor, clang::CXXCtorType::Ctor_Complete}, buf);
             buf.flush();
 
             classNode->constructors.push_back(functionNode);
         }
         else if (const auto dtor = llvm::dyn_cast<clang::CXXDestructorDecl>(method); dtor)
         {
+            // Trivial destructors don't do anything and don't have a symbol, so there's nothing to bind.
+            if (dtor->isTrivial())
+                continue;
+
+            functionNode.isInline = isInline(dtor);
             llvm::raw_string_ostream buf{functionNode.mangledName};
-            mangler->mangleName(clang::GlobalDecl{dtor, clang::CXXDtorType::Dtor_Base}, buf);
+            mangler->mangleName(clang::GlobalDecl{dtor, clang::CXXDtorType::Dtor_Complete}, buf);
             buf.flush();
 
             classNode->destructor = functionNode;
@@ -160,7 +382,17 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
         else
         {
             functionNode.returnType = typeFromClangType(method->getReturnType(), method);
+            functionNode.hasReturnSlot = needsReturnSlot(method, functionNode.returnType);
             functionNode.isNoreturn = method->isNoReturn();
+            // Virtual methods are emitted along with the vtable, so they always have a symbol.
+            functionNode.isInline = isInline(method) && !method->isVirtual();
+            if (method->isVirtual() && !classDecl->isDependentType())
+            {
+                // Only the Itanium C++ ABI is supported, which is also what makes the vtable layout predictable.
+                auto &context = classDecl->getASTContext();
+                if (const auto vtables = llvm::dyn_cast<clang::ItaniumVTableContext>(context.getVTableContext()); vtables)
+                    functionNode.vtableIndex = vtables->getMethodVTableIndex(method);
+            }
 
             llvm::raw_string_ostream buf{functionNode.mangledName};
             mangler->mangleName(method, buf);
@@ -170,6 +402,32 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
         }
     }
 
+    // A thread-safe class is thread-compatible as well. The bindings treat both the same, since they only ever call
+    // non-const methods through exclusive references.
+    for (const auto attr : classDecl->specific_attrs<clang::AnnotateAttr>())
+    {
+        if (attr->getAnnotation() == "polyglot::thread_safe" || attr->getAnnotation() == "polyglot::thread_compatible")
+            classNode->isThreadCompatible = true;
+    }
+
+    // The layout is only known for complete definitions; for anything else, the size stays 0 so that no layout checks
+    // get generated.
+    const clang::ASTRecordLayout *layout = nullptr;
+    if (classDecl->isCompleteDefinition() && !classDecl->isDependentType() && !classDecl->isInvalidDecl())
+    {
+        auto &context = classDecl->getASTContext();
+        layout = &context.getASTRecordLayout(classDecl);
+        classNode->size = layout->getSize().getQuantity();
+        classNode->alignment = layout->getAlignment().getQuantity();
+        classNode->isTriviallyCopyable = classDecl->isTriviallyCopyable() && classDecl->canPassInRegisters();
+        classNode->isPolymorphic = classDecl->isDynamicClass();
+        classNode->isExplicitlyAligned = classDecl->getMaxAlignment() > 0;
+        if (classDecl->hasAttr<clang::PackedAttr>())
+            classNode->packing = 1;
+        else if (const auto pack = classDecl->getAttr<clang::MaxFieldAlignmentAttr>(); pack)
+            classNode->packing = pack->getAlignment() / context.getCharWidth();
+    }
+
     for (const auto &member : classDecl->fields())
     {
         polyglot::VariableNode m;
@@ -177,12 +435,38 @@ void CppParser::addClass(const clang::CXXRecordDecl *classDecl, const std::strin
         m.type = typeFromClangType(member->getType(), member);
         if (member->getInClassInitializer())
             m.value = getExprValue(member->getInClassInitializer(), classDecl->getASTContext());
+        if (layout && !member->isBitField())
+        {
+            auto &context = classDecl->getASTContext();
+            m.offset = layout->getFieldOffset(member->getFieldIndex()) / context.getCharWidth();
+            m.size = context.getTypeSizeInChars(member->getType()).getQuantity();
+            m.alignment = context.getTypeAlignInChars(member->getType()).getQuantity();
+        }
         classNode->members.push_back(m);
     }
 
+    for (const auto decl : classDecl->decls())
+    {
+        if (const auto variable = llvm::dyn_cast<clang::VarDecl>(decl); variable && variable->isStaticDataMember())
+        {
+            if (auto constant = constantFromVarDecl(variable))
+                classNode->constants.push_back(*constant);
+        }
+    }
+
+    classNode->iteratorValueType = getIteratorValueType(classDecl);
+
     pushNodeToProperNS(ast, classDecl, classNode);
 }
 
+void CppParser::writeLayoutReport(LayoutReportWriter::Format format, std::ostream &out) const
+{
+    std::vector<const polyglot::AST *> asts;
+    for (const auto &[moduleName, ast] : m_asts)
+        asts.push_back(&ast);
+    LayoutReportWriter{format}.write(asts, out);
+}
+
 void CppParser::writeWrappers()
 {
     for (auto &[moduleName, ast] : m_asts)
@@ -225,20 +509,136 @@ void CppParser::writeWrappers()
 
 polyglot::QualifiedType CppParser::typeFromClangType(const clang::QualType &type, const clang::Decl *decl) const
 {
+    // Array parameters are adjusted to pointers to their first element. The bindings take a pointer to the whole array
+    // instead, which has the same address, so that the extents aren't lost.
+    if (const auto decayed = type->getAs<clang::DecayedType>(); decayed && decayed->getOriginalType()->isConstantArrayType())
+    {
+        auto ret = typeFromClangType(decayed->getOriginalType(), decl);
+        if (ret.isPointer)
+            throw std::runtime_error("Array parameters are only supported with builtin types, enums and classes as elements");
+        ret.isArray = false;
+        ret.isPointer = true;
+        return ret;
+    }
+
     clang::QualType underlyingType = type;
 
     polyglot::QualifiedType ret;
     ret.isConst = type.isConstQualified();
     ret.isPointer = type->isPointerType();
     ret.isArray = type->isArrayType();
-    ret.isReference = type->isReferenceType();
+    ret.isReference = type->isLValueReferenceType();
+    ret.isRvalueReference = type->isRValueReferenceType();
     ret.isVolatile = type.isVolatileQualified();
 
     if (ret.isPointer)
         underlyingType = type->getPointeeType();
+    else if (type->isReferenceType())
+    {
+        // A reference itself can't be const; what matters is whether the referenced type is.
+        underlyingType = type.getNonReferenceType();
+        ret.isConst = underlyingType.isConstQualified();
+    }
 
     using polyglot::Type;
-    if (underlyingType->isVoidType() || type->isVoidPointerType())
+
+    const auto &context = decl->getASTContext();
+    if (const auto arrayType = context.getAsConstantArrayType(underlyingType); arrayType)
+    {
+        if (ret.isPointer || ret.isRvalueReference)
+            throw std::runtime_error("Pointers to arrays are not supported");
+
+        // The qualifiers of an array apply to its elements, so the element type has to be looked at with all extents
+        // stripped at once.
+        auto element = typeFromClangType(context.getBaseElementType(underlyingType), decl);
+        if (element.baseType >= Type::CppStdString && element.baseType != Type::FunctionPointer)
+            throw std::runtime_error("Arrays are only supported with builtin types, enums, pointers and classes as "
+                                     "elements");
+        for (auto dimension = arrayType; dimension; dimension = context.getAsConstantArrayType(dimension->getElementType()))
+            element.arrayExtents.push_back(dimension->getSize().getZExtValue());
+
+        // A reference to an array is passed like a pointer to it, just like an array parameter.
+        if (ret.isReference)
+        {
+            if (element.isPointer)
+                throw std::runtime_error("References to arrays are only supported with builtin types, enums and classes "
+                                         "as elements");
+            element.isPointer = true;
+        }
+        else
+            element.isArray = true;
+        return element;
+    }
+
+    // Callbacks are passed to C++ as plain C function pointers, so their signatures are limited to types that can be
+    // passed like in C.
+    auto addSignature = [this, decl, &ret](const clang::FunctionProtoType *proto) {
+        ret.templateArguments.push_back(typeFromClangType(proto->getReturnType(), decl));
+        for (const auto &paramType : proto->getParamTypes())
+            ret.templateArguments.push_back(typeFromClangType(paramType, decl));
+        for (const auto &type : ret.templateArguments)
+        {
+            if (type.baseType >= Type::CppStdString || type.isReference || type.isRvalueReference)
+                throw std::runtime_error("Callbacks can only take and return builtin types, enums, pointers and trivially "
+                                         "copyable classes by value");
+        }
+    };
+
+    if (const auto proto = underlyingType->getAs<clang::FunctionProtoType>(); proto && ret.isPointer)
+    {
+        // The function pointer is the type itself, not a pointer to something else.
+        ret.isPointer = false;
+        ret.baseType = Type::FunctionPointer;
+        addSignature(proto);
+    }
+    else if (const auto vectorType = underlyingType->getAs<clang::VectorType>(); vectorType)
+    {
+        // GNU vectors (e.g. __m128) and ext_vector_type vectors are passed in vector registers, so the bindings map them
+        // to the vector types of their languages rather than to arrays. Their elements are always plain integers or
+        // floats, regardless of how the intrinsics headers spell them (e.g. long long for __m128i).
+        const auto elementQualType = vectorType->getElementType();
+        const auto elementSize = decl->getASTContext().getTypeSize(elementQualType);
+        polyglot::QualifiedType elementType;
+        if (elementQualType->isFloatingType() && elementSize == 32)
+            elementType.baseType = Type::Float32;
+        else if (elementQualType->isFloatingType() && elementSize == 64)
+            elementType.baseType = Type::Float64;
+        else if (elementQualType->isIntegerType() && !elementQualType->isBooleanType())
+        {
+            const auto uint = elementQualType->isUnsignedIntegerType();
+            switch (elementSize)
+            {
+            case 8:
+                elementType.baseType = uint ? Type::Uint8 : Type::Int8;
+                break;
+            case 16:
+                elementType.baseType = uint ? Type::Uint16 : Type::Int16;
+                break;
+            case 32:
+                elementType.baseType = uint ? Type::Uint32 : Type::Int32;
+                break;
+            case 64:
+                elementType.baseType = uint ? Type::Uint64 : Type::Int64;
+                break;
+            }
+        }
+        if (elementType.baseType == Type::Undefined)
+            throw std::runtime_error("Vectors are only supported with 8- to 64-bit integer and 32- or 64-bit "
+                                     "floating-point elements");
+
+        // Vectors with other lane counts (e.g. float3) are padded, and not every target language pads them the same way.
+        const auto lanes = vectorType->getNumElements();
+        if (!llvm::isPowerOf2_32(lanes))
+            throw std::runtime_error("Vectors are only supported with a power-of-two number of lanes");
+
+        ret.baseType = Type::Vector;
+        ret.elementCount = lanes;
+        ret.templateArguments.push_back(elementType);
+        ret.qualifiedName = clang::TypeName::getFullyQualifiedName(underlyingType.getUnqualifiedType(),
+                                                                   decl->getASTContext(),
+                                                                   decl->getASTContext().getPrintingPolicy());
+    }
+    else if (underlyingType->isVoidType() || type->isVoidPointerType())
         ret.baseType = Type::Void;
     else if (underlyingType->isBooleanType())
         ret.baseType = Type::Bool;
@@ -304,19 +704,197 @@ polyglot::QualifiedType CppParser::typeFromClangType(const clang::QualType &type
     {
         ret.baseType = Type::Enum;
         ret.nameString = enumType->getDecl()->getNameAsString();
+        ret.qualifiedName = enumType->getDecl()->getQualifiedNameAsString();
     }
-    else if (CppUtils::isStdString(type))
+    else if (CppUtils::isStdString(underlyingType))
         ret.baseType = Type::CppStdString;
-    else if (auto classType = (underlyingType->getAsCXXRecordDecl()))
+    else if (CppUtils::isStdVector(underlyingType))
     {
-        ret.baseType = Type::Class;
-        ret.nameString = classType->getName();
+        // Vectors are handed to the bindings as owning handles, which only the proxies of free functions convert from
+        // and to. The proxy lends C++ the handle's vector, so it can't be moved from either.
+        const auto param = llvm::dyn_cast<clang::ParmVarDecl>(decl);
+        const auto function = param ? llvm::dyn_cast<clang::FunctionDecl>(param->getDeclContext())
+                                    : llvm::dyn_cast<clang::FunctionDecl>(decl);
+        if (!function || llvm::isa<clang::CXXMethodDecl>(function) || ret.isPointer || ret.isRvalueReference)
+            throw std::runtime_error("std::vector is only supported for parameters and return values of free functions "
+                                     "that pass it by value or by lvalue reference");
+
+        const auto elementQualType = CppUtils::getTemplateArgumentType(underlyingType, 0);
+        if (elementQualType.isNull())
+            throw std::runtime_error("Could not determine the element type of std::vector");
+
+        auto elementType = typeFromClangType(elementQualType, decl);
+        // std::vector<bool> has no contiguous storage, so it can't be handed out as a slice.
+        if (elementType.baseType < Type::Char || elementType.baseType > Type::Float128 || elementType.isPointer)
+            throw std::runtime_error("std::vector is only supported with fixed-width element types");
+
+        ret.baseType = Type::CppStdVector;
+        ret.templateArguments.push_back(elementType);
+        ret.usesPolymorphicAllocator = CppUtils::usesPolymorphicAllocator(underlyingType);
+    }
+    else if (CppUtils::isStdMap(underlyingType) || CppUtils::isStdUnorderedMap(underlyingType))
+    {
+        // Maps are bound through owning handles like vectors, with the same restrictions.
+        const auto param = llvm::dyn_cast<clang::ParmVarDecl>(decl);
+        const auto function = param ? llvm::dyn_cast<clang::FunctionDecl>(param->getDeclContext())
+                                    : llvm::dyn_cast<clang::FunctionDecl>(decl);
+        if (!function || llvm::isa<clang::CXXMethodDecl>(function) || ret.isPointer || ret.isRvalueReference)
+            throw std::runtime_error("Maps are only supported for parameters and return values of free functions that "
+                                     "pass them by value or by lvalue reference");
+
+        ret.baseType = CppUtils::isStdMap(underlyingType) ? Type::CppStdMap : Type::CppStdUnorderedMap;
+        ret.usesPolymorphicAllocator = CppUtils::usesPolymorphicAllocator(underlyingType);
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            const auto argQualType = CppUtils::getTemplateArgumentType(underlyingType, i);
+            if (argQualType.isNull())
+                throw std::runtime_error("Could not determine the key or value type of a map");
+
+            // Entries are copied out of the map in chunks, so both the keys and the values have to be plain values.
+            auto argType = typeFromClangType(argQualType, decl);
+            if (argType.baseType < Type::Bool || argType.baseType > Type::Float128 || argType.isPointer)
+                throw std::runtime_error("Maps are only supported with builtin key and value types");
+            ret.templateArguments.push_back(argType);
+        }
+    }
+    else if (CppUtils::isStdFunction(underlyingType))
+    {
+        // std::function is bound through a shim that builds it from a C callback and a context pointer, which only
+        // works for parameters of free functions that don't get modified.
+        const auto param = llvm::dyn_cast<clang::ParmVarDecl>(decl);
+        const auto function = param ? llvm::dyn_cast<clang::FunctionDecl>(param->getDeclContext()) : nullptr;
+        if (!function || llvm::isa<clang::CXXMethodDecl>(function) || ret.isPointer ||
+            (ret.isReference && !ret.isConst) || ret.isRvalueReference)
+            throw std::runtime_error("std::function is only supported for parameters of free functions that take it by "
+                                     "value or by const reference");
+
+        const auto signature = CppUtils::getTemplateArgumentType(underlyingType, 0);
+        const auto proto = signature.isNull() ? nullptr : signature->getAs<clang::FunctionProtoType>();
+        if (!proto)
+            throw std::runtime_error("Could not determine the signature of std::function");
+
+        ret.baseType = Type::CppStdFunction;
+        addSignature(proto);
+    }
+    else if (CppUtils::isStdFuture(underlyingType))
+    {
+        // A future is handed to the bindings as an owning handle that they can wait on without blocking, which only
+        // works for the result of a free function.
+        const auto function = llvm::dyn_cast<clang::FunctionDecl>(decl);
+        if (!function || llvm::isa<clang::CXXMethodDecl>(function) || ret.isPointer || ret.isReference ||
+            ret.isRvalueReference)
+            throw std::runtime_error("std::future is only supported as the return type of free functions");
+
+        const auto valueQualType = CppUtils::getTemplateArgumentType(underlyingType, 0);
+        if (valueQualType.isNull())
+            throw std::runtime_error("Could not determine the value type of std::future");
+
+        // The value is copied out of the future once it is ready, so it has to be a plain value.
+        auto valueType = typeFromClangType(valueQualType, decl);
+        if (valueType.baseType > Type::Float64 || valueType.baseType == Type::Int128 ||
+            valueType.baseType == Type::Uint128 || valueType.isPointer || valueType.isReference || valueType.isArray)
+            throw std::runtime_error("std::future is only supported with builtin value types and void");
+
+        ret.baseType = Type::CppStdFuture;
+        ret.templateArguments.push_back(valueType);
     }
-    else if (auto rValue = underlyingType->getAs<clang::RValueReferenceType>())
+    else if (CppUtils::isStdUniquePtr(underlyingType))
     {
-        ret.isRvalueReference = true;
-        auto qt = rValue->getPointeeType();
-        ret.nameString = qt.getAsString();
+        // A std::unique_ptr is passed through the proxy as the raw pointer that it owns, and the bindings wrap that in an
+        // owning handle of the same size. That only works for free functions that take or return it by value.
+        const auto param = llvm::dyn_cast<clang::ParmVarDecl>(decl);
+        const auto function = param ? llvm::dyn_cast<clang::FunctionDecl>(param->getDeclContext())
+                                    : llvm::dyn_cast<clang::FunctionDecl>(decl);
+        if (!function || llvm::isa<clang::CXXMethodDecl>(function) || ret.isPointer || ret.isReference ||
+            ret.isRvalueReference)
+            throw std::runtime_error("std::unique_ptr is only supported for parameters and return values of free "
+                                     "functions that pass it by value");
+        if (!CppUtils::usesDefaultDeleter(underlyingType))
+            throw std::runtime_error("std::unique_ptr is only supported with the default deleter");
+
+        const auto pointeeQualType = CppUtils::getTemplateArgumentType(underlyingType, 0);
+        if (pointeeQualType.isNull())
+            throw std::runtime_error("Could not determine the pointee type of std::unique_ptr");
+        if (pointeeQualType->isArrayType())
+            throw std::runtime_error("std::unique_ptr is not supported with arrays");
+
+        // The pointee is never passed by value, so it is looked at through a pointer.
+        auto pointeeType = typeFromClangType(decl->getASTContext().getPointerType(pointeeQualType), decl);
+        pointeeType.isPointer = false;
+        if (pointeeType.baseType == Type::Void || pointeeType.baseType > Type::Class)
+            throw std::runtime_error("std::unique_ptr is only supported with builtin types, enums and classes as "
+                                     "pointees");
+
+        ret.baseType = Type::CppStdUniquePtr;
+        ret.templateArguments.push_back(pointeeType);
+    }
+    else if (CppUtils::isStdSharedPtr(underlyingType))
+    {
+        // A std::shared_ptr is bound like a container: the bindings own a heap-allocated copy of it, which they lend to
+        // C++ by pointer. Only a non-const reference could change the pointee behind the handle's back.
+        const auto param = llvm::dyn_cast<clang::ParmVarDecl>(decl);
+        const auto function = param ? llvm::dyn_cast<clang::FunctionDecl>(param->getDeclContext())
+                                    : llvm::dyn_cast<clang::FunctionDecl>(decl);
+        if (!function || llvm::isa<clang::CXXMethodDecl>(function) || ret.isPointer || ret.isRvalueReference ||
+            (ret.isReference && (!param || !ret.isConst)))
+            throw std::runtime_error("std::shared_ptr is only supported for parameters of free functions that take it "
+                                     "by value or by const reference and for return values of free functions");
+
+        const auto pointeeQualType = CppUtils::getTemplateArgumentType(underlyingType, 0);
+        if (pointeeQualType.isNull())
+            throw std::runtime_error("Could not determine the pointee type of std::shared_ptr");
+        if (pointeeQualType->isArrayType())
+            throw std::runtime_error("std::shared_ptr is not supported with arrays");
+
+        // The pointee is never passed by value, so it is looked at through a pointer.
+        auto pointeeType = typeFromClangType(decl->getASTContext().getPointerType(pointeeQualType), decl);
+        pointeeType.isPointer = false;
+        if (pointeeType.baseType == Type::Void || pointeeType.baseType > Type::Class)
+            throw std::runtime_error("std::shared_ptr is only supported with builtin types, enums and classes as "
+                                     "pointees");
+
+        ret.baseType = Type::CppStdSharedPtr;
+        ret.templateArguments.push_back(pointeeType);
+    }
+    else if (CppUtils::isStdOptional(underlyingType))
+    {
+        // A std::optional of a trivially copyable type is trivially copyable itself and laid out as the value followed
+        // by a bool, so the bindings pass it by value as a struct with the same layout.
+        const auto valueQualType = CppUtils::getTemplateArgumentType(underlyingType, 0);
+        if (valueQualType.isNull())
+            throw std::runtime_error("Could not determine the value type of std::optional");
+
+        auto valueType = typeFromClangType(valueQualType, decl);
+        if (valueType.baseType == Type::Void || valueType.baseType > Type::Class || valueType.isPointer ||
+            !valueType.arrayExtents.empty() || !valueQualType.isTriviallyCopyableType(decl->getASTContext()))
+            throw std::runtime_error("std::optional is only supported with trivially copyable builtin types, enums and "
+                                     "classes as values");
+
+        ret.baseType = Type::CppStdOptional;
+        ret.templateArguments.push_back(valueType);
+    }
+    else if (CppUtils::isStdMemoryResource(underlyingType))
+    {
+        // The bindings can create memory resources that allocate from their own allocators, but they can only hand
+        // them out by pointer.
+        if (!ret.isPointer)
+            throw std::runtime_error("std::pmr::memory_resource is only supported through pointers");
+        ret.baseType = Type::CppStdMemoryResource;
+    }
+    else if (auto classType = (underlyingType->getAsCXXRecordDecl()))
+    {
+        ret.baseType = Type::Class;
+        ret.nameString = CppUtils::getBindingName(classType);
+        ret.qualifiedName = CppUtils::getQualifiedCppName(classType);
+
+        // Parameters of class type are passed like C structs by the bindings. That is only correct if C++ does the same,
+        // i.e. if the class is trivially copyable; otherwise, C++ passes it through a hidden pointer. Return values like
+        // that are constructed in a return slot instead (see needsReturnSlot()).
+        const auto isPassedByValue = !ret.isPointer && !type->isReferenceType() && llvm::isa<clang::ParmVarDecl>(decl);
+        if (isPassedByValue && classType->hasDefinition() &&
+            !(classType->isTriviallyCopyable() && classType->canPassInRegisters()))
+            throw std::runtime_error(std::format("`{}` is not trivially copyable, so it can't be passed by value",
+                                                 ret.nameString));
     }
     else
         throw std::runtime_error(std::format("Unrecognized type: {}", ret.nameString));
@@ -324,6 +902,58 @@ polyglot::QualifiedType CppParser::typeFromClangType(const clang::QualType &type
     return ret;
 }
 
+std::optional<polyglot::QualifiedType> CppParser::getIteratorValueType(const clang::CXXRecordDecl *classDecl) const
+{
+    auto findAccessor = [classDecl](std::string_view name) -> const clang::CXXMethodDecl * {
+        for (const auto &method : classDecl->methods())
+        {
+            if (method->getNameAsString() == name && !method->isStatic() && method->getNumParams() == 0 &&
+                method->getAccess() == clang::AS_public)
+                return method;
+        }
+        return nullptr;
+    };
+
+    const auto begin = findAccessor("begin");
+    if (!begin || !findAccessor("end"))
+        return std::nullopt;
+
+    // The iterator is either a plain pointer or a class with an operator*(); either way, dereferencing it gives us the
+    // element type.
+    const auto iteratorType = begin->getReturnType().getNonReferenceType();
+    clang::QualType elementType;
+    if (iteratorType->isPointerType())
+        elementType = iteratorType->getPointeeType();
+    else if (const auto iteratorDecl = iteratorType->getAsCXXRecordDecl(); iteratorDecl)
+    {
+        const auto name = classDecl->getASTContext().DeclarationNames.getCXXOperatorName(clang::OO_Star);
+        for (const auto decl : iteratorDecl->lookup(name))
+        {
+            if (const auto deref = llvm::dyn_cast<clang::CXXMethodDecl>(decl); deref && deref->getNumParams() == 0)
+            {
+                elementType = deref->getReturnType();
+                break;
+            }
+        }
+    }
+    if (elementType.isNull())
+        return std::nullopt;
+
+    // Iteration copies elements out in chunks, so only plain values can be iterated over. Anything else just doesn't
+    // get an iterator rather than failing the whole class.
+    try
+    {
+        auto type = typeFromClangType(elementType.getNonReferenceType().getUnqualifiedType(), classDecl);
+        if (type.baseType < polyglot::Type::Bool || type.baseType > polyglot::Type::Float128 || type.isPointer)
+            return std::nullopt;
+        return type;
+    }
+    catch (const std::runtime_error &)
+    {
+        return std::nullopt;
+    }
+}
+
 void CppParser::pushNodeToProperNS(polyglot::AST &ast, const clang::Decl *decl, polyglot::ASTNode *node) const
 {
     auto nsList = CppUtils::getNamespaceList(decl);
@@ -10,7 +10,11 @@
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
 
+#include <set>
+
+#include "../core/LayoutReportWriter.h"
 #include "../core/PolyglotAST.h"
+#include "CppUtils.h"
 
 enum class BindingType
 {
@@ -36,11 +40,20 @@ public:
     void addFunction(const clang::FunctionDecl *function, const std::string &filename);
     void addEnum(const clang::EnumDecl *e, const std::string &filename);
     void addClass(const clang::CXXRecordDecl *classDecl, const std::string &filename);
+    void addVariable(const clang::VarDecl *variable, const std::string &filename);
 
     void writeWrappers();
+    //! Writes a report about the memory layout of every class that was found instead of writing wrappers.
+    void writeLayoutReport(LayoutReportWriter::Format format, std::ostream &out) const;
 
 private:
     polyglot::QualifiedType typeFromClangType(const clang::QualType &qualType, const clang::Decl *decl) const;
+    //! Returns `variable` along with its value if it is a constexpr variable of a builtin type. Constants of other types
+    //! are left out, since they can't be written as literals in every language.
+    std::optional<polyglot::VariableNode> constantFromVarDecl(const clang::VarDecl *variable) const;
+    //! Returns the element type if the class can be iterated over with begin() and end(), and it is one that can be copied
+    //! out in chunks.
+    std::optional<polyglot::QualifiedType> getIteratorValueType(const clang::CXXRecordDecl *classDecl) const;
     void pushNodeToProperNS(polyglot::AST &ast, const clang::Decl *decl, polyglot::ASTNode *node) const;
 
     std::map<std::string, polyglot::AST> m_asts;
@@ -59,12 +72,16 @@ public:
     {
         if (const clang::FunctionDecl *function = result.Nodes.getNodeAs<clang::FunctionDecl>("function"))
         {
-            if (function->isTemplated() || function->isCXXClassMember() ||
-                function->getNameAsString() == "polyglot_make_sure_symbols_are_kept_by_the_linker")
+            // Templates only get bindings for the specializations that are instantiated explicitly, since those are the
+            // only ones that are guaranteed to have symbols.
+            if (function->isTemplated() || CppUtils::isImplicitInstantiation(function) || function->isCXXClassMember() ||
+                function->getNameAsString() == "polyglot_make_sure_symbols_are_kept_by_the_linker" ||
+                isDuplicateInstantiation(function))
                 return;
 
-            const auto filename = result.SourceManager->getFilename(function->getLocation()).str();
-            if (result.SourceManager->isInSystemHeader(function->getLocation()) || filename.empty())
+            const auto location = CppUtils::getModuleLocation(function);
+            const auto filename = result.SourceManager->getFilename(location).str();
+            if (result.SourceManager->isInSystemHeader(location) || filename.empty())
                 return;
 
             try
@@ -104,11 +121,13 @@ public:
         }
         else if (const clang::CXXRecordDecl *classDecl = result.Nodes.getNodeAs<clang::CXXRecordDecl>("class"))
         {
-            if (classDecl->isTemplated() || classDecl->isImplicit())
+            if (classDecl->isTemplated() || classDecl->isImplicit() || CppUtils::isImplicitInstantiation(classDecl) ||
+                isDuplicateInstantiation(classDecl))
                 return;
 
-            const auto filename = result.SourceManager->getFilename(classDecl->getLocation()).str();
-            if (result.SourceManager->isInSystemHeader(classDecl->getLocation()) || filename.empty())
+            const auto location = CppUtils::getModuleLocation(classDecl);
+            const auto filename = result.SourceManager->getFilename(location).str();
+            if (result.SourceManager->isInSystemHeader(location) || filename.empty())
                 return;
 
             try
@@ -124,10 +143,48 @@ public:
                 diagnostics.Report(classDecl->getBeginLoc(), id);
             }
         }
+        else if (const clang::VarDecl *variable = result.Nodes.getNodeAs<clang::VarDecl>("variable"))
+        {
+            // Only variables at namespace scope that other translation units can link against get bindings. Every
+            // redeclaration is matched, so only the first one is handled.
+            // Constants are the exception, since the bindings define them themselves.
+            // isFileVarDecl() is also true for static data members, which would lose their class qualification here.
+            // static constexpr members are bound as class constants by addClass() instead, so that they aren't written
+            // twice.
+            if (variable->isTemplated() || !variable->isFileVarDecl() || variable->isStaticDataMember() ||
+                (!variable->isExternallyVisible() && !variable->isConstexpr()) || !variable->isFirstDecl())
+                return;
+
+            const auto filename = result.SourceManager->getFilename(variable->getLocation()).str();
+            if (result.SourceManager->isInSystemHeader(variable->getLocation()) || filename.empty())
+                return;
+
+            try
+            {
+                m_generator.addVariable(variable, filename);
+            }
+            catch (const std::runtime_error &e)
+            {
+                auto &diagnostics = variable->getASTContext().getDiagnostics();
+                auto id = diagnostics.getDiagnosticIDs()->getCustomDiagID(
+                    clang::DiagnosticIDs::Error,
+                    std::format("Could not wrap variable `{}`: {}", variable->getNameAsString(), e.what()));
+                diagnostics.Report(variable->getBeginLoc(), id);
+            }
+        }
     }
 
     void save() { m_generator.writeWrappers(); }
+    void report(LayoutReportWriter::Format format, std::ostream &out) const { m_generator.writeLayoutReport(format, out); }
 
 private:
+    //! Explicit instantiations can be matched more than once (through the template and through the instantiation
+    //! itself), so this returns whether `decl` has already been added, and remembers it otherwise.
+    bool isDuplicateInstantiation(const clang::NamedDecl *decl)
+    {
+        return CppUtils::isExplicitInstantiation(decl) && !m_instantiations.insert(decl->getCanonicalDecl()).second;
+    }
+
     CppParser m_generator;
+    std::set<const clang::Decl *> m_instantiations;
 };
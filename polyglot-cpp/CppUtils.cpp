@@ -4,8 +4,41 @@
 
 #include "CppUtils.h"
 
+#include <cctype>
 #include <iostream>
 
+namespace
+{
+    //! Checks whether `type` (or the type it points to) is a specialization of the standard library template `name`.
+    bool isStdTemplate(const clang::QualType &type, std::string_view name)
+    {
+        auto t = type.getTypePtr();
+        const auto *record = t->isPointerType() ? t->getPointeeCXXRecordDecl() : t->getAsCXXRecordDecl();
+        if (!record || !llvm::isa<clang::ClassTemplateSpecializationDecl>(record))
+            return false;
+        return record->getQualifiedNameAsString() == name;
+    }
+
+    //! Returns the template arguments of `decl` if it is a class or function template specialization.
+    const clang::TemplateArgumentList *getSpecializationArgs(const clang::NamedDecl *decl)
+    {
+        if (const auto specialization = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(decl))
+            return &specialization->getTemplateArgs();
+        if (const auto function = llvm::dyn_cast<clang::FunctionDecl>(decl))
+            return function->getTemplateSpecializationArgs();
+        return nullptr;
+    }
+
+    clang::TemplateSpecializationKind getSpecializationKind(const clang::NamedDecl *decl)
+    {
+        if (const auto specialization = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(decl))
+            return specialization->getSpecializationKind();
+        if (const auto function = llvm::dyn_cast<clang::FunctionDecl>(decl))
+            return function->getTemplateSpecializationKind();
+        return clang::TSK_Undeclared;
+    }
+} // namespace
+
 bool CppUtils::isStdString(const clang::QualType &type)
 {
     auto t = type.getTypePtr();
@@ -15,6 +48,69 @@ bool CppUtils::isStdString(const clang::QualType &type)
     return record->getQualifiedNameAsString() == "std::basic_string";
 }
 
+bool CppUtils::isStdVector(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::vector");
+}
+
+bool CppUtils::isStdMap(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::map");
+}
+
+bool CppUtils::isStdUnorderedMap(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::unordered_map");
+}
+
+bool CppUtils::isStdFunction(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::function");
+}
+
+bool CppUtils::isStdFuture(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::future");
+}
+
+bool CppUtils::isStdMemoryResource(const clang::QualType &type)
+{
+    const auto *record = type->getAsCXXRecordDecl();
+    return record && record->getQualifiedNameAsString() == "std::pmr::memory_resource";
+}
+
+bool CppUtils::usesPolymorphicAllocator(const clang::QualType &type)
+{
+    // The allocator is the last template argument of every standard container.
+    const auto *record = llvm::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+    if (!record || record->getTemplateArgs().size() == 0)
+        return false;
+    const auto &allocator = record->getTemplateArgs()[record->getTemplateArgs().size() - 1];
+    return allocator.getKind() == clang::TemplateArgument::Type &&
+           isStdTemplate(allocator.getAsType(), "std::pmr::polymorphic_allocator");
+}
+
+bool CppUtils::isStdUniquePtr(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::unique_ptr");
+}
+
+bool CppUtils::usesDefaultDeleter(const clang::QualType &type)
+{
+    const auto deleter = getTemplateArgumentType(type, 1);
+    return !deleter.isNull() && isStdTemplate(deleter, "std::default_delete");
+}
+
+bool CppUtils::isStdSharedPtr(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::shared_ptr");
+}
+
+bool CppUtils::isStdOptional(const clang::QualType &type)
+{
+    return isStdTemplate(type, "std::optional");
+}
+
 bool CppUtils::isFixedWidthIntegerType(const clang::QualType &type)
 {
     auto checkName = [](const std::string_view name) {
@@ -40,6 +136,92 @@ bool CppUtils::isFixedWidthIntegerType(const clang::QualType &type)
     return false;
 }
 
+bool CppUtils::isExplicitInstantiation(const clang::NamedDecl *decl)
+{
+    const auto kind = getSpecializationKind(decl);
+    return kind == clang::TSK_ExplicitInstantiationDeclaration || kind == clang::TSK_ExplicitInstantiationDefinition;
+}
+
+bool CppUtils::isImplicitInstantiation(const clang::NamedDecl *decl)
+{
+    return getSpecializationKind(decl) == clang::TSK_ImplicitInstantiation;
+}
+
+clang::SourceLocation CppUtils::getModuleLocation(const clang::NamedDecl *decl)
+{
+    clang::SourceLocation location;
+    if (isExplicitInstantiation(decl))
+    {
+        if (const auto specialization = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(decl))
+            location = specialization->getPointOfInstantiation();
+        else if (const auto function = llvm::dyn_cast<clang::FunctionDecl>(decl))
+            location = function->getPointOfInstantiation();
+    }
+    return location.isValid() ? location : decl->getLocation();
+}
+
+std::string CppUtils::getTemplateArgumentsString(const clang::NamedDecl *decl)
+{
+    const auto args = getSpecializationArgs(decl);
+    if (!args)
+        return {};
+
+    std::string ret;
+    llvm::raw_string_ostream out(ret);
+    clang::printTemplateArgumentList(out, args->asArray(), decl->getASTContext().getPrintingPolicy());
+    return out.str();
+}
+
+std::string CppUtils::getBindingName(const clang::NamedDecl *decl)
+{
+    std::string suffix;
+    auto separate = [&suffix] {
+        if (!suffix.empty() && suffix.back() != '_')
+            suffix += '_';
+    };
+    for (const auto c : getTemplateArgumentsString(decl))
+    {
+        if (std::isalnum(static_cast<unsigned char>(c)))
+            suffix += c;
+        else if (c == '*' || c == '&' || c == '-')
+        {
+            // These change the meaning of an argument, so they can't just be dropped like the other punctuation.
+            separate();
+            suffix += c == '*' ? "ptr" : c == '&' ? "ref" : "neg";
+        }
+        else
+            separate();
+    }
+    while (!suffix.empty() && suffix.back() == '_')
+        suffix.pop_back();
+
+    const auto name = decl->getNameAsString();
+    return suffix.empty() ? name : name + '_' + suffix;
+}
+
+std::string CppUtils::getQualifiedCppName(const clang::NamedDecl *decl)
+{
+    return decl->getQualifiedNameAsString() + getTemplateArgumentsString(decl);
+}
+
+clang::QualType CppUtils::getTemplateArgumentType(const clang::QualType &type, unsigned index)
+{
+    // Prefer the arguments as they were written so that typedefs like int32_t survive; the canonical specialization
+    // only knows about the underlying builtin types.
+    if (const auto *specialization = type->getAs<clang::TemplateSpecializationType>(); specialization)
+    {
+        const auto args = specialization->template_arguments();
+        if (index < args.size() && args[index].getKind() == clang::TemplateArgument::Type)
+            return args[index].getAsType();
+    }
+
+    const auto *record = llvm::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+    if (!record || index >= record->getTemplateArgs().size())
+        return {};
+    const auto &arg = record->getTemplateArgs()[index];
+    return arg.getKind() == clang::TemplateArgument::Type ? arg.getAsType() : clang::QualType{};
+}
+
 std::vector<std::string> CppUtils::getNamespaceList(const clang::Decl *decl)
 {
     std::vector<std::string> ret;
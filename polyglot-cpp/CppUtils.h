@@ -11,8 +11,43 @@
 namespace CppUtils
 {
     bool isStdString(const clang::QualType &type);
+    bool isStdVector(const clang::QualType &type);
+    bool isStdMap(const clang::QualType &type);
+    bool isStdUnorderedMap(const clang::QualType &type);
+    bool isStdFunction(const clang::QualType &type);
+    bool isStdFuture(const clang::QualType &type);
+    bool isStdMemoryResource(const clang::QualType &type);
+    //! Whether `type` is a standard library container that uses std::pmr::polymorphic_allocator.
+    bool usesPolymorphicAllocator(const clang::QualType &type);
+    bool isStdUniquePtr(const clang::QualType &type);
+    //! Whether `type` is a std::unique_ptr that frees its pointee with std::default_delete.
+    bool usesDefaultDeleter(const clang::QualType &type);
+    bool isStdSharedPtr(const clang::QualType &type);
+    bool isStdOptional(const clang::QualType &type);
     bool isFixedWidthIntegerType(const clang::QualType &type);
 
+    //! Returns the type of the template argument at `index` for a class template specialization (e.g. `int32_t` for
+    //! `std::vector<int32_t>` and index 0). Returns a null type if there is no such type argument.
+    clang::QualType getTemplateArgumentType(const clang::QualType &type, unsigned index);
+
     //! Returns a list of namespace names, starting with the outermost namespace.
     std::vector<std::string> getNamespaceList(const clang::Decl *decl);
+
+    //! Whether `decl` is a class or function template specialization that was explicitly instantiated (e.g. with
+    //! `template class Foo<float>;` or `extern template class Foo<float>;`). The symbols of those are guaranteed to exist.
+    bool isExplicitInstantiation(const clang::NamedDecl *decl);
+    //! Whether `decl` is a class or function template specialization that was only instantiated implicitly.
+    bool isImplicitInstantiation(const clang::NamedDecl *decl);
+    //! Returns the template arguments of a class or function template specialization as they are written in C++ (e.g.
+    //! "<float, 3>"), or an empty string if `decl` is not a specialization.
+    std::string getTemplateArgumentsString(const clang::NamedDecl *decl);
+    //! Returns the location that decides which module `decl` belongs to. Explicit instantiations belong to the file that
+    //! instantiates them rather than to the one that defines the template.
+    clang::SourceLocation getModuleLocation(const clang::NamedDecl *decl);
+    //! Returns the name that the bindings use for `decl`. Every template specialization needs a name of its own, so the
+    //! template arguments are appended to it (e.g. "Vec_float_3" for `Vec<float, 3>`).
+    std::string getBindingName(const clang::NamedDecl *decl);
+    //! Returns the name that generated C++ code uses to refer to `decl`, including its namespaces and template arguments
+    //! (e.g. "math::Vec<float, 3>").
+    std::string getQualifiedCppName(const clang::NamedDecl *decl);
 } // namespace CppUtils
@@ -19,6 +19,7 @@ DeclarationMatcher enumMatcher = enumDecl().bind("enum");
 // we need unless(isImplicit()) to prevent double matching of classes; see
 // https://stackoverflow.com/questions/55088770/why-clang-ast-shows-two-cxxrecorddecl-for-a-single-class
 DeclarationMatcher classMatcher = cxxRecordDecl(unless(isImplicit())).bind("class");
+DeclarationMatcher variableMatcher = varDecl(hasGlobalStorage()).bind("variable");
 
 static llvm::cl::OptionCategory polyglotOptions("polyglot options");
 static llvm::cl::extrahelp commonHelp(CommonOptionsParser::HelpMessage);
@@ -33,6 +34,13 @@ static llvm::cl::list<polyglot::Language> languages{
                      clEnumValN(polyglot::Language::Zig, "zig", "Zig")),
     llvm::cl::ZeroOrMore,
     llvm::cl::cat(polyglotOptions)};
+static llvm::cl::opt<LayoutReportWriter::Format> layoutReport{
+    "layout-report",
+    llvm::cl::desc{"Instead of generating wrappers, print a report about the memory layout of every class (padding, "
+                   "cache line crossings and a suggested member order)."},
+    llvm::cl::values(clEnumValN(LayoutReportWriter::Format::Text, "text", "Human-readable text"),
+                     clEnumValN(LayoutReportWriter::Format::Json, "json", "JSON")),
+    llvm::cl::cat(polyglotOptions)};
 static llvm::cl::opt<std::string> outputDir{"output-dir",
                                             llvm::cl::desc{"The directory to output wrappers into. By default, this is set "
                                                            "to the current directory."}};
@@ -63,9 +71,12 @@ int main(int argc, const char **argv)
     finder.addMatcher(functionMatcher, &visitor);
     finder.addMatcher(enumMatcher, &visitor);
     finder.addMatcher(classMatcher, &visitor);
+    finder.addMatcher(variableMatcher, &visitor);
 
     auto retval = tool.run(newFrontendActionFactory(&finder).get());
-    if (retval == 0)
+    if (retval == 0 && layoutReport.getNumOccurrences() > 0)
+        visitor.report(layoutReport.getValue(), std::cout);
+    else if (retval == 0)
         visitor.save();
     else
         std::cerr << "Source wrapping failed" << std::endl;